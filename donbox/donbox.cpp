@@ -2,7 +2,6 @@
 #include <eosio/asset.hpp>
 #include <eosio/print.hpp>
 #include <eosio/system.hpp>
-#include <math.h>
 
 #include "donbox.hpp"
 #include "../include/eosio.token.hpp"
@@ -18,9 +17,9 @@ void donbox::donation_in(eosio::name& from, eosio::name& to, eosio::asset& sum,
   
   if(from == get_self()) return;  //if it's a withdrawal
 
-  const auto contrit = _currencies.find(sum.symbol);
-  check(contrit != _currencies.end(), "This currency is not accepted");
-  check(get_first_receiver()==contrit->second, "Wrong token contract");
+  const auto cur = get_currency(sum.symbol);
+  check(cur != nullptr, "This currency is not accepted");
+  check(get_first_receiver()==cur->contract, "Wrong token contract");
 
   //memo = account name donation is for
   check(memo.length()<13, "Specify donation receiver in the memo and try again");
@@ -28,83 +27,459 @@ void donbox::donation_in(eosio::name& from, eosio::name& to, eosio::asset& sum,
   name receiver(memo);
   check(is_account(receiver), "Memo should contain the donation receiver. No such user: " + memo);
 
-  balances balance(get_self(), get_self().value);  
-  auto it = balance.find(receiver.value);
+  const auto conf = configs(get_self(), get_self().value).get_or_default();
 
-  if (it != balance.end()){
+  //only the row of this currency is read and written
+  balances balance(get_self(), receiver.value);  
+  auto it = balance.find(sum.symbol.code().raw());
+  const bool exists = it != balance.end();
+  const auto funds = exists ? it->funds + sum : sum;
+  const uint32_t donors = exists ? it->donors + 1 : 1;
+  const bool reached = funds.amount >= get_minimum(conf, funds.symbol);
+
+  //receiver row is only read for new balances and when minimum is reached
+  receivers recvs(get_self(), get_self().value);
+  auto rit = recvs.end();
+  if(!exists || reached){
+    rit = recvs.find(receiver.value);
+    if(rit == recvs.end()){
+      rit = recvs.emplace(get_self(), [&](auto &row) {
+        row.username = receiver;
+      });
+    }
+  }
+
+  if(reached && rit->autopay){
+    //push payout: funds never stay in the table, no withdraw needed
+    if(exists) balance.erase(it);
+    pay(receiver, funds, donors);
+  }
+  else if (exists){
     
     balance.modify(it, get_self(), [&](auto &row) {
-      if(row.funds.count(sum.symbol.code()))
-        row.funds[sum.symbol.code()] += sum;
-      else
-        row.funds[sum.symbol.code()] = sum;
-      row.donors++;
+      row.funds = funds;
+      row.donors = donors;
     });
   }
   else {
     balance.emplace(get_self(), [&](auto &row) {
-      row.username = receiver;
-      row.funds[sum.symbol.code()] = sum;
-      row.donors = 1;
+      row.funds = funds;
+      row.donors = donors;
     });
   }
 
   history hist(get_self(), get_self().value);
+  hist_states states(get_self(), get_self().value);
+  auto state = get_hist_state(hist);
   hist.emplace( get_self(), [&]( auto& rec ) {
-    rec.id = hist.available_primary_key();
+    rec.id = state.next_id++;
     rec.sender = from;
     rec.receiver = receiver;
     rec.sum = sum;
     rec.timestamp = current_time_point();
   });
+  state.size++;
+
+  //bounded history: roll the oldest records into aggregates, at most 2 per donation after capacity was lowered
+  const auto capacity = conf.hist_capacity;
+  auto hit = hist.begin();
+  for(int i = 0; i < 2 && capacity && state.size > capacity; i++, state.size--, state.rolled++)
+    hit = roll(hist, hit);
+
+  states.set(state, get_self());
+}
+
+donbox::hist_state donbox::get_hist_state(history& hist){
+
+  hist_states states(get_self(), get_self().value);
+  if(states.exists()) return states.get();
+
+  //history written before the state existed has no gaps in ids
+  hist_state state;
+  state.next_id = hist.available_primary_key();
+  if(hist.begin() != hist.end()){
+    state.size = state.next_id - hist.begin()->id;
+    state.unindexed_end = state.next_id;
+    state.reindex_next = hist.begin()->id;
+  }
+  return state;
+}
+
+void donbox::check_indexed(history& hist){
+
+  const auto state = get_hist_state(hist);
+  check(state.reindex_next >= state.unindexed_end, "History is being reindexed, call reindex until it reports 0 rows");
+}
+
+donbox::history::const_iterator donbox::roll(history& hist, history::const_iterator it){
+
+  const auto& rec = *it;
+  const auto code = rec.sum.symbol.code();
+  const uint32_t day = rec.timestamp.sec_since_epoch() / 86400;
+
+  recv_aggs raggs(get_self(), rec.receiver.value);
+  auto rit = raggs.find(code.raw());
+  if(rit == raggs.end()){
+    raggs.emplace(get_self(), [&](auto &row) {
+      row.sum = rec.sum;
+      row.count = 1;
+      row.first = row.last = rec.timestamp;
+    });
+  }
+  else {
+    raggs.modify(rit, get_self(), [&](auto &row) {
+      row.sum += rec.sum;
+      row.count++;
+      row.last = rec.timestamp;
+    });
+  }
+
+  day_aggs daggs(get_self(), code.raw());
+  auto dit = daggs.find(day);
+  if(dit == daggs.end()){
+    daggs.emplace(get_self(), [&](auto &row) {
+      row.day = day;
+      row.sum = rec.sum;
+      row.count = 1;
+      row.first = row.last = rec.timestamp;
+    });
+  }
+  else {
+    daggs.modify(dit, get_self(), [&](auto &row) {
+      row.sum += rec.sum;
+      row.count++;
+      row.last = rec.timestamp;
+    });
+  }
+
+  return hist.erase(it);
+}
+
+[[eosio::action]]
+void donbox::sethistcap(uint32_t capacity){
+
+  require_auth(_self);
+  configs conf(get_self(), get_self().value);
+  auto c = conf.get_or_default();
+  c.hist_capacity = capacity;
+  conf.set(c, get_self());
+}
+
+[[eosio::action]]
+void donbox::prunehist(eosio::time_point_sec before, uint32_t max_rows){
+
+  require_auth(_self);
+  check(max_rows > 0, "Specify number of rows to process");
+
+  history hist(get_self(), get_self().value);
+  hist_states states(get_self(), get_self().value);
+  auto state = get_hist_state(hist);
+
+  //ids grow with time, so the oldest records are always first
+  uint32_t rolled = 0;
+  for(auto it = hist.begin(); it != hist.end() && rolled < max_rows && it->timestamp < eosio::time_point(before); rolled++)
+    it = roll(hist, it);
 
+  state.size -= rolled;
+  state.rolled += rolled;
+  states.set(state, get_self());
+
+  print("Rolled ", rolled, " records into aggregates, ", state.size, " left in history\n");
 }
 
 [[eosio::action]]
-void donbox::deletedata(){
+void donbox::reindex(uint32_t max_rows){
 
   require_auth(_self);
-  balances tab(_self, get_self().value);
-  auto itr = tab.begin();
-  while(itr != tab.end()){
-      itr = tab.erase(itr);
+  check(max_rows > 0, "Specify number of rows to process");
+
+  history hist(get_self(), get_self().value);
+  hist_states states(get_self(), get_self().value);
+  auto state = get_hist_state(hist);
+
+  //erase skips missing secondary keys, emplace with the same id writes all of them
+  uint32_t moved = 0;
+  for(auto it = hist.lower_bound(state.reindex_next); it != hist.end() && it->id < state.unindexed_end && moved < max_rows; moved++){
+    const auto rec = *it;
+    hist.erase(it);
+    hist.emplace(get_self(), [&](auto &row) {
+      row = rec;
+    });
+    state.reindex_next = rec.id + 1;
+    it = hist.lower_bound(state.reindex_next);
+  }
+  if(moved < max_rows) state.reindex_next = state.unindexed_end;
+  states.set(state, get_self());
+
+  print("Reindexed ", moved, " history records\n");
+}
+
+template <typename Index>
+donbox::hist_page donbox::get_page(const Index& index, uint128_t from, uint128_t to, uint16_t limit){
+
+  check(limit > 0 && limit <= MAX_PAGE, "Page size should be from 1 to " + to_string(MAX_PAGE));
+
+  hist_page page{ {}, 0 };
+  for(auto it = index.lower_bound(from); it != index.end(); it++){
+    const auto key = Index::extract_secondary_key(*it);
+    if(key > to) break;
+    if(page.records.size() == limit){
+      page.next = key;
+      break;
+    }
+    page.records.push_back(*it);
   }
+  return page;
 }
+
+[[eosio::action, eosio::read_only]]
+donbox::hist_page donbox::getbyrecv(eosio::name receiver, uint128_t cursor, uint16_t limit){
+
+  history hist(get_self(), get_self().value);
+  check_indexed(hist);
+  const auto from = cursor ? cursor : hist_record::key(receiver.value, 0);
+  check(from >> 64 == receiver.value, "Cursor is for another receiver");
+
+  return get_page(hist.get_index<"byreceiver"_n>(), from, hist_record::key(receiver.value, UINT64_MAX), limit);
+}
+
+[[eosio::action, eosio::read_only]]
+donbox::hist_page donbox::getbysender(eosio::name sender, uint128_t cursor, uint16_t limit){
+
+  history hist(get_self(), get_self().value);
+  check_indexed(hist);
+  const auto from = cursor ? cursor : hist_record::key(sender.value, 0);
+  check(from >> 64 == sender.value, "Cursor is for another sender");
+
+  return get_page(hist.get_index<"bysender"_n>(), from, hist_record::key(sender.value, UINT64_MAX), limit);
+}
+
+[[eosio::action, eosio::read_only]]
+donbox::hist_page donbox::getbytime(eosio::time_point_sec from, eosio::time_point_sec to, uint128_t cursor, uint16_t limit){
+
+  check(from <= to, "Wrong time range");
+  const uint64_t lo = eosio::time_point(from).time_since_epoch().count();
+  const uint64_t hi = eosio::time_point(to).time_since_epoch().count();
+
+  history hist(get_self(), get_self().value);
+  check_indexed(hist);
+  const auto start = cursor ? cursor : hist_record::key(lo, 0);
+  check(start >= hist_record::key(lo, 0), "Cursor is out of time range");
+
+  return get_page(hist.get_index<"bytime"_n>(), start, hist_record::key(hi, UINT64_MAX), limit);
+}
+
+donbox::old_balances::const_iterator donbox::migrate(old_balances& old, old_balances::const_iterator it){
+
+  const auto user = it->username;
+  balances balance(get_self(), user.value);
+  for(const auto& p: it->funds){
+    //donations made after upgrade are already in funds
+    auto bit = balance.find(p.first.raw());
+    if(bit == balance.end()){
+      balance.emplace(get_self(), [&](auto &row) {
+        row.funds = p.second;
+        row.donors = it->donors;
+      });
+    }
+    else {
+      balance.modify(bit, get_self(), [&](auto &row) {
+        row.funds += p.second;
+        row.donors += it->donors;
+      });
+    }
+  }
+
+  receivers recvs(get_self(), get_self().value);
+  if(recvs.find(user.value) == recvs.end()){
+    recvs.emplace(get_self(), [&](auto &row) {
+      row.username = user;
+    });
+  }
+
+  return old.erase(it);
+}
+
+[[eosio::action]]
+void donbox::migratebal(uint32_t max_rows){
+
+  require_auth(_self);
+  check(max_rows > 0, "Specify number of rows to process");
+
+  old_balances old(get_self(), get_self().value);
+  uint32_t moved = 0;
+  for(auto it = old.begin(); it != old.end() && moved < max_rows; moved++)
+    it = migrate(old, it);
+
+  print("Migrated ", moved, " balances\n");
+}
+
+void donbox::pay(eosio::name user, const eosio::asset& tokens, uint32_t donors){
+
+  eosio::token::transfer_action transfer(get_currency(tokens.symbol)->contract, { get_self(), "active"_n });
+  transfer.send( get_self(), user, tokens, tokens.to_string()+" from "+to_string(donors)+" donor(s)");
+  
+  /*  //another way to action
+    action{
+      permission_level{get_self(), "active"_n},
+      "eosio.token"_n,
+      "transfer"_n,
+      std::make_tuple(get_self(), user, tokens, tokens.to_string()+" from "+to_string(donors)+" donor(s)")
+    }.send();
+  */
+}
+
+[[eosio::action]]
+void donbox::setautopay(eosio::name user, bool enabled){
+
+  require_auth(user);
+  receivers recvs(get_self(), get_self().value);
+  auto rit = recvs.find(user.value);
+  if(rit == recvs.end()){
+    //user hasn't received anything yet, so the row is on their RAM
+    recvs.emplace(user, [&](auto &row) {
+      row.username = user;
+      row.autopay = enabled;
+    });
+  }
+  else {
+    recvs.modify(rit, eosio::same_payer, [&](auto &row) {
+      row.autopay = enabled;
+    });
+  }
+}
+
+int64_t donbox::get_minimum(const config& conf, eosio::symbol sym){
+
+  for(const auto& m: conf.minimums)
+    if(m.symbol == sym) return m.amount;
+
+  const auto cur = get_currency(sym);
+  check(cur != nullptr, "This currency is not accepted");
+  return cur->min_amount;
+}
+
+[[eosio::action]]
+void donbox::setminimum(eosio::asset minimum){
+
+  require_auth(_self);
+  check(get_currency(minimum.symbol) != nullptr, "This currency is not accepted");
+  check(minimum.amount >= 0, "Minimum can't be negative");
+
+  configs conf(get_self(), get_self().value);
+  auto c = conf.get_or_default();
+  auto& mins = c.minimums;
+  mins.erase(remove_if(mins.begin(), mins.end(), [&](const asset& m){ return m.symbol == minimum.symbol; }), mins.end());
+  if(minimum.amount) mins.push_back(minimum);
+  conf.set(c, get_self());
+}
+
+//erase up to {budget} rows of {tab} from the start, returns number of erased rows
+template <typename Table>
+static uint32_t erase_rows(Table& tab, uint32_t budget){
+
+  uint32_t erased = 0;
+  for(auto itr = tab.begin(); itr != tab.end() && erased < budget; erased++)
+    itr = tab.erase(itr);
+  return erased;
+}
+
+[[eosio::action]]
+donbox::cleanup_res donbox::deletedata(uint32_t max_rows){
+
+  require_auth(_self);
+  check(max_rows > 0, "Specify number of rows to process");
+
+  //rows are erased from the start of every table, so stage is the only cursor needed
+  cleanups cleanup(_self, get_self().value);
+  auto state = cleanup.get_or_default();
+  uint32_t erased = 0;
+
+  if(state.stage == 0){
+    //users with a legacy balance may have no receiver row, their scopes are walked the same way before the old row goes
+    //receiver or old balance row goes last, so a user with rows left is picked up again by the next call
+    old_balances old(_self, get_self().value);
+    for(auto oitr = old.begin(); oitr != old.end() && erased < max_rows; ){
+      balances tab(_self, oitr->username.value);
+      recv_aggs raggs(_self, oitr->username.value);
+      erased += erase_rows(tab, max_rows - erased);
+      erased += erase_rows(raggs, max_rows - erased);
+      if(erased == max_rows) break;
+      oitr = old.erase(oitr);
+      erased++;
+    }
+
+    receivers recvs(_self, get_self().value);
+    for(auto ritr = recvs.begin(); ritr != recvs.end() && erased < max_rows; ){
+      balances tab(_self, ritr->username.value);
+      recv_aggs raggs(_self, ritr->username.value);
+      erased += erase_rows(tab, max_rows - erased);
+      erased += erase_rows(raggs, max_rows - erased);
+      if(erased == max_rows) break;
+      ritr = recvs.erase(ritr);
+      erased++;
+    }
+    if(old.begin() == old.end() && recvs.begin() == recvs.end()) state.stage++;
+  }
+
+  if(state.stage == 1){
+    history hist(_self, get_self().value);
+    erased += erase_rows(hist, max_rows - erased);
+    if(hist.begin() == hist.end()){
+      hist_states(_self, get_self().value).remove();
+      state.stage++;
+    }
+  }
+
+  if(state.stage == 2){
+    for(const auto& c: CURRENCIES){
+      day_aggs daggs(_self, c.sym.code().raw());
+      erased += erase_rows(daggs, max_rows - erased);
+      if(daggs.begin() != daggs.end()) break;
+    }
+    if(erased < max_rows) state.stage++;
+  }
+
+  state.reclaimed += erased;
+  cleanup_res res{ erased, state.reclaimed, state.stage > 2 };
+  if(res.done) cleanup.remove();
+  else cleanup.set(state, get_self());
+
+  print("Erased ", erased, " rows, ", state.reclaimed, " in total", res.done ? ", done\n" : ", call again\n");
+  return res;
+}
+
 [[eosio::action]]
 void donbox::withdraw(eosio::name user){
 
   require_auth(user);
 
-  balances balance(get_self(), get_self().value);    
+  //balance may still be in old format if migratebal didn't reach it yet
+  old_balances old(get_self(), get_self().value);
+  auto oit = old.find(user.value);
+  if(oit != old.end()) migrate(old, oit);
+
+  balances balance(get_self(), user.value);    
+  check(balance.begin() != balance.end(), "You don't have any donations, sorry");
 
-  const auto& rec = balance.get(user.value, "You don't have any donations, sorry");
+  const auto conf = configs(get_self(), get_self().value).get_or_default();
 
-  vector<asset> to_transfer;
-  for(auto& p: rec.funds){
-    if(p.second.amount/pow(10, p.second.symbol.precision()) >= _threshold)
-      to_transfer.push_back(p.second);
+  vector<bal_record> to_transfer;
+  for(auto& rec: balance){
+    if(rec.funds.amount >= get_minimum(conf, rec.funds.symbol))
+      to_transfer.push_back(rec);
   }
 
-  check(to_transfer.size(), "Nothing to witdraw. Must have at least " + to_string(_threshold) + " of any tokens");
-  
-  eosio::token::transfer_action transfer("eosio.token"_n, { get_self(), "active"_n });
-  for(auto& tokens: to_transfer){
+  if(to_transfer.empty()){
+    string mins;
+    for(const auto& c: CURRENCIES)
+      mins += (mins.empty() ? "" : ", ") + asset{ get_minimum(conf, c.sym), c.sym }.to_string();
+    check(false, "Nothing to witdraw. Must have at least " + mins);
+  }
   
-    print("Transferring ", tokens.to_string(), " to ", user, "\n");
-    transfer.send( get_self(), user, tokens, tokens.to_string()+" from "+to_string(rec.donors)+" donor(s)");
-    
-    /*  //another way to action
-      action{
-        permission_level{get_self(), "active"_n},
-        "eosio.token"_n,
-        "transfer"_n,
-        std::make_tuple(get_self(), user, tokens, tokens.to_string()+" from "+to_string(rec.donors)+" donor(s)")
-      }.send();
-    */
-    balance.modify(rec, get_self(), [&](auto &row) {
-      row.funds.erase(tokens.symbol.code());
-    });
-
+  for(auto& rec: to_transfer){
+    pay(user, rec.funds, rec.donors);
+    balance.erase(balance.find(rec.funds.symbol.code().raw()));
   }
 
-}
\ No newline at end of file
+}
@@ -1,27 +1,64 @@
 #include <eosio/eosio.hpp>
 #include <eosio/asset.hpp>
+#include <eosio/singleton.hpp>
 
 using namespace eosio;
 using namespace std;
 
-const uint64_t MIN_WITHDRAWAL = 1000;
+const uint64_t MIN_WITHDRAWAL = 1000;     //default withdrawal threshold in whole tokens
+const uint16_t MAX_PAGE = 100;            //records returned by one history query
+
+//accepted currency and its default withdrawal minimum in token units
+struct currency {
+  eosio::symbol sym;
+  eosio::name contract;
+  int64_t min_amount;
+};
+
+//units in one whole token with {precision} decimals
+constexpr int64_t token_units(uint8_t precision) { return precision ? 10 * token_units(precision - 1) : 1; }
+
+constexpr currency CURRENCIES[] = {
+  {{"EOS", 4}, "eosio.token"_n, MIN_WITHDRAWAL * token_units(4)},
+  {{"SYS", 4}, "eosio.token"_n, MIN_WITHDRAWAL * token_units(4)}
+};
+
+//currency with {sym} symbol or nullptr if it's not accepted
+constexpr const currency* get_currency(eosio::symbol sym) {
+  for(const auto& c: CURRENCIES)
+    if(c.sym == sym) return &c;
+  return nullptr;
+}
 
 class [[eosio::contract("donbox")]] donbox : public eosio::contract{       
     
-    const uint64_t _threshold;
-    const map<eosio::symbol, eosio::name> _currencies = {
-      {{"EOS", 4}, "eosio.token"_n},
-      {{"SYS", 4}, "eosio.token"_n}
+    //funds donated to a user in one currency, scope - user
+    struct [[eosio::table]] bal_record {
+        eosio::asset funds;
+        uint32_t donors;
+        uint64_t primary_key() const { return funds.symbol.code().raw(); }
     };
 
-    struct [[eosio::table]] bal_record {
+    typedef eosio::multi_index< "funds"_n, bal_record > balances;
+
+    //balances of contract versions that kept all currencies of a user in one row, moved to funds by migratebal or withdraw
+    struct [[eosio::table]] old_bal_record {
         eosio::name username;
         uint32_t donors;
         std::map<eosio::symbol_code, eosio::asset>  funds;
         uint64_t primary_key() const { return username.value;} 
     };
 
-    typedef eosio::multi_index< "balances"_n, bal_record > balances;
+    typedef eosio::multi_index< "balances"_n, old_bal_record > old_balances;
+
+    //users that have been donated to, lets balances be walked across scopes
+    struct [[eosio::table]] recv_record {
+        eosio::name username;
+        bool autopay = false;             //pay out funds as soon as they reach withdrawal minimum
+        uint64_t primary_key() const { return username.value; }
+    };
+
+    typedef eosio::multi_index< "receivers"_n, recv_record > receivers;
 
     struct [[eosio::table]] hist_record {
       uint64_t id;                        //auto-inc id
@@ -30,19 +67,111 @@ class [[eosio::contract("donbox")]] donbox : public eosio::contract{
       eosio::asset sum;
       eosio::time_point timestamp;  
       uint64_t primary_key() const { return id; }
+
+      //id in low bits keeps records of one key in order they were made and doubles as a page cursor
+      static uint128_t key(uint64_t hi, uint64_t id) { return static_cast<uint128_t>(hi) << 64 | id; }
+      uint128_t by_receiver() const { return key(receiver.value, id); }
+      uint128_t by_sender() const { return key(sender.value, id); }
+      uint128_t by_time() const { return key(timestamp.time_since_epoch().count(), id); }
+    };
+
+    typedef eosio::multi_index <"history"_n, hist_record,
+      indexed_by<"byreceiver"_n, const_mem_fun<hist_record, uint128_t, &hist_record::by_receiver>>,
+      indexed_by<"bysender"_n, const_mem_fun<hist_record, uint128_t, &hist_record::by_sender>>,
+      indexed_by<"bytime"_n, const_mem_fun<hist_record, uint128_t, &hist_record::by_time>>
+    > history;
+
+    //history position: ids keep growing, table holds at most config::hist_capacity of the latest records
+    struct [[eosio::table]] hist_state {
+      uint64_t next_id = 0;               //id of the next record
+      uint32_t size = 0;                  //records in history table
+      uint64_t rolled = 0;                //records rolled into aggregates so far
+      uint64_t unindexed_end = 0;         //records with smaller ids were written before secondary indexes existed
+      uint64_t reindex_next = 0;          //id of the next of those records to reindex
+    };
+
+    typedef eosio::singleton<"histstate"_n, hist_state> hist_states;
+
+    //contract settings
+    struct [[eosio::table]] config {
+      uint32_t hist_capacity = 0;         //records kept in history, older ones are rolled into aggregates, 0 - keep all
+      vector<eosio::asset> minimums;      //withdrawal minimums overriding CURRENCIES defaults
+    };
+
+    typedef eosio::singleton<"config"_n, config> configs;
+
+    //donations rolled out of history per receiver and currency, scope - receiver
+    struct [[eosio::table]] recv_agg {
+      eosio::asset sum;
+      uint32_t count;
+      eosio::time_point first;
+      eosio::time_point last;
+      uint64_t primary_key() const { return sum.symbol.code().raw(); }
+    };
+
+    typedef eosio::multi_index <"recvagg"_n, recv_agg> recv_aggs;
+
+    //donations rolled out of history per day and currency, scope - currency symbol code
+    struct [[eosio::table]] day_agg {
+      uint32_t day;                       //days since epoch
+      eosio::asset sum;
+      uint32_t count;
+      eosio::time_point first;
+      eosio::time_point last;
+      uint64_t primary_key() const { return day; }
     };
 
-    typedef eosio::multi_index <"history"_n, hist_record> history;
+    typedef eosio::multi_index <"dayagg"_n, day_agg> day_aggs;
+
+    //progress of deletedata between calls
+    struct [[eosio::table]] cleanup_state {
+      uint8_t stage = 0;                  //0 - balances (old and per currency) and receiver aggregates, 1 - history, 2 - day aggregates
+      uint64_t reclaimed = 0;             //rows erased so far
+    };
+
+    typedef eosio::singleton<"cleanup"_n, cleanup_state> cleanups;
+
+    //withdrawal minimum of {sym} in token units
+    static int64_t get_minimum(const config& conf, eosio::symbol sym);
+
+    //send {tokens} donated by {donors} to {user}
+    void pay(eosio::name user, const eosio::asset& tokens, uint32_t donors);
+
+    //move old balance row to funds rows of its user and erase it
+    //returns iterator to the next row
+    old_balances::const_iterator migrate(old_balances& old, old_balances::const_iterator it);
+
+    //current history state, set up from existing records on first use
+    hist_state get_hist_state(history& hist);
+
+    //fail history queries until records written before secondary indexes are reindexed
+    void check_indexed(history& hist);
+
+    //add history record to aggregates and erase it
+    //returns iterator to the next record
+    history::const_iterator roll(history& hist, history::const_iterator it);
 
 public:
     donbox(eosio::name rec, eosio::name code, datastream<const char*> ds) 
       : contract(rec, code, ds)
-      , _threshold(MIN_WITHDRAWAL)
     {};
 
-    // clear database
+    //page of history query, pass {next} back as cursor to get the following page, 0 - no more records
+    struct hist_page {
+      vector<hist_record> records;
+      uint128_t next;
+    };
+
+    //result of one deletedata call
+    struct cleanup_res {
+      uint32_t reclaimed;                 //rows erased by this call
+      uint64_t total;                     //rows erased since cleanup started
+      bool done;                          //all data is cleared
+    };
+
+    // clear database erasing up to {max_rows} rows, call again until it reports done
     [[eosio::action]]
-    void deletedata();
+    cleanup_res deletedata(uint32_t max_rows);
 
     // called when transfer happens to update tables
     [[eosio::on_notify("*::transfer")]]   
@@ -52,6 +181,51 @@ public:
     [[eosio::action]]
     void withdraw(eosio::name user);
 
+    // move up to {max_rows} balances kept in old format into per currency rows
+    // call again until it reports 0 rows
+    [[eosio::action]]
+    void migratebal(uint32_t max_rows);
+
+    // pay out donations to {user} automatically when they reach withdrawal minimum
+    [[eosio::action]]
+    void setautopay(eosio::name user, bool enabled);
+
+    // set withdrawal minimum for {minimum} currency, 0 - back to default
+    [[eosio::action]]
+    void setminimum(eosio::asset minimum);
+
+    // keep only {capacity} latest donations in history, older ones are kept as per receiver and per day aggregates
+    // 0 - keep all of them
+    [[eosio::action]]
+    void sethistcap(uint32_t capacity);
+
+    // roll up to {max_rows} oldest history records made before {before} into aggregates
+    // call again until it reports 0 rows
+    [[eosio::action]]
+    void prunehist(eosio::time_point_sec before, uint32_t max_rows);
+
+    // write up to {max_rows} history records made before secondary indexes existed again, so queries find them
+    // call again until it reports 0 rows
+    [[eosio::action]]
+    void reindex(uint32_t max_rows);
+
+    // donations received by {receiver}, oldest first, up to {limit} records from {cursor}, 0 - from the start
+    [[eosio::action, eosio::read_only]]
+    hist_page getbyrecv(eosio::name receiver, uint128_t cursor, uint16_t limit);
+
+    // donations made by {sender}, oldest first
+    [[eosio::action, eosio::read_only]]
+    hist_page getbysender(eosio::name sender, uint128_t cursor, uint16_t limit);
+
+    // donations made in [{from}, {to}], oldest first
+    [[eosio::action, eosio::read_only]]
+    hist_page getbytime(eosio::time_point_sec from, eosio::time_point_sec to, uint128_t cursor, uint16_t limit);
+
     using withdraw_action = eosio::action_wrapper<"withdraw"_n, &donbox::withdraw>;
+
+private:
+    //records of {index} with keys in [{from}, {to}], up to {limit} of them
+    template <typename Index>
+    hist_page get_page(const Index& index, uint128_t from, uint128_t to, uint16_t limit);
 };
    
@@ -3,15 +3,7 @@
 #include <eosio/print.hpp>
 
 #include <eosio.token.hpp>
-#include <registry.sx.hpp>
-#include <defibox.hpp>
-#include <dfs.hpp>
-#include <uniswap.hpp>
 #include <flash.sx.hpp>
-#include <swap.sx.hpp>
-#include <hamburger.hpp>
-#include <pizza.hpp>
-#include <sapex.hpp>
 
 
 #include "basic.hpp"
@@ -26,375 +18,355 @@ void basic::mine(name executor, extended_asset ext_quantity) {
   if (!has_auth("miner.sx"_n)) require_auth(get_self());
 
 
+  //{ext_quantity} caps the stake, route search picks the optimal size below it
   auto arb = get_best_arb_opportunity(ext_quantity);
-  auto quantity = ext_quantity.quantity;
-  auto contract = ext_quantity.contract;
-/*
-  print( "Best profit: " + arb.exp_profit.to_string() +
-    " "+quantity.symbol.code().to_string()+"/" + arb.symbol.code().to_string() +
-    " " + arb.dex_sell + "->" + arb.dex_buy );
-*/
+  auto quantity = arb.stake.quantity;
   check( arb.exp_profit.amount > 0,
-    "No profits for "+quantity.to_string()+
-    ". Closest: " + arb.exp_profit.to_string() + " with " + arb.symbol.code().to_string() +
-    " " + arb.dex_sell + "=>" + arb.dex_buy );
-
-  basic::arbplan _arbplan( get_self(), get_self().value );
-  _arbplan.set(arb, get_self());
-
-  //borrow stake
-  flash::borrow_action borrow( "flash.sx"_n, { get_self(), "active"_n });
-  borrow.send( get_self(), contract, quantity, "Loan", "" );
+    "No profits for up to "+ext_quantity.quantity.to_string()+
+    ". Closest: " + arb.exp_profit.to_string() + " with " + get_route_string(quantity.symbol, arb.route) );
 
+  execute(executor, arb);
 }
 
 [[eosio::action]]
-void basic::trade(asset tokens, asset minreturn, string exchange){
+void basic::minebatch(name executor, vector<extended_asset> candidates) {
 
-  check( tokens.amount > 0 && minreturn.amount > 0, "Invalid tokens amount" );
-  auto [dex, out, tcontract, memo] = get_trade_data(exchange, tokens, minreturn.symbol);
+  if (!has_auth("miner.sx"_n)) require_auth(get_self());
+  check( candidates.size(), "No candidates" );
 
-  check(minreturn <= out || minreturn.amount==0, "Return is not enough");
+  //one pair cache and snapshot for all candidates: registry rows and reserves are read once
+  const auto ref = candidates[0].quantity.symbol;
+  market::pair_cache pairs(get_source(), ref.code());
+  market::snapshot market(pairs);
 
-  // log out price
-  log_action log( get_self(), { get_self(), "active"_n });
-  log.send( out );
+  //profits in different tokens are compared in the first candidate's token
+  arbparams best;
+  int64_t best_value = 0;
+  for(const auto& c: candidates){
+    auto arb = get_best_arb_opportunity(market, c);
+    if(arb.exp_profit.amount <= 0) continue;
+
+    const auto value = get_value(market, arb.exp_profit, ref);
+    if(value > best_value){
+      best_value = value;
+      best = move(arb);
+    }
+  }
 
-  // make a swap
-  token::transfer_action transfer( tcontract, { get_self(), "active"_n });
-  transfer.send( get_self(), dex, tokens, memo);
+  check( best_value > 0, "No profits for " + to_string(candidates.size()) + " candidates" );
 
+  execute(executor, best);
 }
 
-asset basic::make_trade(asset tokens, symbol sym, string exchange){
-
-  check( tokens.amount > 0, "Invalid tokens amount" );
-
-  auto [dex, out, tcontract, memo] = get_trade_data(exchange, tokens, sym);
-
-  check(out.amount > 0, "Trade pair not supported");
-  print("Sending "+tokens.to_string()+" to "+dex.to_string()+" to buy "+sym.code().to_string()+" with memo "+memo+"\n");
-
-  // make a trade
-  token::transfer_action transfer( tcontract, { get_self(), "active"_n });
-  transfer.send( get_self(), dex, tokens, memo);
-
-  return out;
+void basic::execute(name executor, arbparams arb){
 
-}
+  //plans are keyed by id so several arbitrages can wait for their loans in one transaction
+  basic::arbplans _arbplans( get_self(), get_self().value );
+  arb.id = _arbplans.available_primary_key();
+  arb.executor = executor;
+  _arbplans.emplace( get_self(), [&]( auto& row ) { row = arb; });
 
-basic::tradeparams basic::get_trade_data(string exchange, asset tokens, symbol to){
-
-  if(exchange == "defibox")
-    return get_defi_trade_data(tokens, to);
-  if(exchange == "dfs")
-    return get_dfs_trade_data(tokens, to);
-  if(exchange == "swap.sx")
-    return get_swapsx_trade_data(tokens, to);
-  if(exchange == "stable.sx")
-    return get_stablesx_trade_data(tokens, to);
-  if(exchange == "vigor.sx")
-    return get_vigorsx_trade_data(tokens, to);
-  if(exchange == "hamburger")
-    return get_hbg_trade_data(tokens, to);
-  if(exchange == "pizza")
-    return get_pizza_trade_data(tokens, to);
-  if(exchange == "sapex")
-    return get_sapex_trade_data(tokens, to);
-
-  check(false, exchange + " exchange is not supported");
-  return {};  //dummy
+  //borrow stake, flash.sx passes the memo back with the loan
+  flash::borrow_action borrow( "flash.sx"_n, { get_self(), "active"_n });
+  borrow.send( get_self(), arb.stake.contract, arb.stake.quantity, to_string(arb.id), "" );
 
 }
 
+int64_t basic::get_value(market::snapshot& market, asset tokens, symbol in){
 
-basic::tradeparams basic::get_defi_trade_data(asset tokens, symbol to){
+  if(tokens.symbol == in) return tokens.amount;
 
-  sx::registry::swap_defi_table defi_table( "registry.sx"_n, "registry.sx"_n.value );
-
-  auto rowit = defi_table.find(tokens.symbol.code().raw());
-  if(rowit==defi_table.end()) return {};
-  name tcontract = rowit->base.get_contract();
-  string pair_id;
-  for(auto& p: rowit->quotes){
-    if(p.first.get_symbol()==to){
-      pair_id = p.second; break;
-    }
+  //best return of selling {tokens} for {in} on any exchange, 0 if it can't be sold
+  int64_t res = 0;
+  for(uint8_t dex = 0; dex < dex::count; dex++){
+    const auto pair = market.pairs().find(dex, tokens.symbol, in);
+    if(pair) res = max(res, market.get_amount_out(*pair, tokens, in).amount);
   }
-  if(pair_id=="") return {};
-
-  // get reserves
-  const auto [ reserve_in, reserve_out ] = defibox::get_reserves( stoi(pair_id), tokens.symbol );
-  const uint8_t fee = defibox::get_fee();
-
-  // calculate out price
-  const asset out = tokens.amount ? uniswap::get_amount_out( tokens, reserve_in, reserve_out, fee ) : asset {0, out_sym};
-
-  return {"swap.defi"_n, out, tcontract, "swap,0," + pair_id};
+  return res;
 }
 
+[[eosio::action]]
+void basic::trade(asset tokens, asset minreturn, name exchange){
 
+  check( tokens.amount > 0 && minreturn.amount > 0, "Invalid tokens amount" );
+  auto [dex, out, tcontract, memo] = get_trade_data(exchange, tokens, minreturn.symbol);
 
-basic::tradeparams basic::get_dfs_trade_data(asset tokens, symbol out_sym){
-
-  sx::registry::defisswapcnt_table dfs_table( "registry.sx"_n, "registry.sx"_n.value );
-
-  auto rowit = dfs_table.find(tokens.symbol.code().raw());
-  if(rowit==dfs_table.end()) return {};
-  name tcontract = rowit->base.get_contract();
-  string pair_id;
-  for(auto& p: rowit->quotes){
-    if(p.first.get_symbol()==out_sym){
-      pair_id = p.second; break;
-    }
-  }
-  if(pair_id=="") return {};
+  check(minreturn <= out || minreturn.amount==0, "Return is not enough");
 
-  // get reserves
-  const auto [ reserve_in, reserve_out ] = dfs::get_reserves( stoi(pair_id), tokens.symbol );
-  const uint8_t fee = dfs::get_fee();
+  // log out price
+  log_action log( get_self(), { get_self(), "active"_n });
+  log.send( out );
 
-  // calculate out price
-  const asset out = tokens.amount ? uniswap::get_amount_out( tokens, reserve_in, reserve_out, fee ) : asset {0, out_sym};
+  // make a swap
+  token::transfer_action transfer( tcontract, { get_self(), "active"_n });
+  transfer.send( get_self(), dex, tokens, memo);
 
-  return {"defisswapcnt"_n, out, tcontract, "swap:" + pair_id+":0"};
 }
 
-
-
-basic::tradeparams basic::get_hbg_trade_data(asset tokens, symbol out_sym){
-
-  sx::registry::hamburgerswp_table hbg_table( "registry.sx"_n, "registry.sx"_n.value );
-
-  auto rowit = hbg_table.find(tokens.symbol.code().raw());
-  if(rowit==hbg_table.end()) return {};
-  name tcontract = rowit->base.get_contract();
-  string pair_id;
-  for(auto& p: rowit->quotes){
-    if(p.first.get_symbol()==out_sym){
-      pair_id = p.second; break;
-    }
+[[eosio::action]]
+uint32_t basic::checkcurve(name exchange, asset tokens, symbol to, uint32_t samples){
+
+  const auto dex = dex::index_of(exchange);
+  check(dex < dex::count, exchange.to_string() + " exchange is not supported");
+
+  market::pair_cache pairs(get_source(), tokens.symbol.code());
+  market::snapshot market(pairs);
+  const auto pair = pairs.find(dex, tokens.symbol, to);
+  check(pair != nullptr, "No " + tokens.symbol.code().to_string() + "/" + to.code().to_string() + " pair on " + exchange.to_string());
+  check(dex::visit<bool>(dex, [](auto adapter){ return decltype(adapter)::curve; }), exchange.to_string() + " is not a curve exchange");
+
+  //amounts the exchange quotes at or over the pool balance fail on trade, they are left out
+  const auto reserve_out = pairs.source().get_reserves(dex, pair->pair_id, tokens.symbol, to).second;
+
+  //xorshift over log-uniform sizes, so small and large trades are both covered
+  uint64_t rnd = tokens.amount ^ to.raw();
+  check(tokens.amount > 0 && rnd, "Invalid tokens amount");
+  uint32_t compared = 0;
+  for(uint32_t i = 0; i < samples; i++){
+    rnd ^= rnd << 13, rnd ^= rnd >> 7, rnd ^= rnd << 17;
+    const asset in{ 1 + static_cast<int64_t>(rnd % static_cast<uint64_t>(tokens.amount >> (rnd >> 59) | 1)), tokens.symbol };
+
+    const auto reference = pairs.source().get_amount_out(dex, pair->pair_id, in, to);
+    if(reference.amount >= reserve_out.amount) continue;
+
+    const auto local = market.get_amount_out(*pair, in, to);
+    check(local == reference, "Curve mismatch for " + in.to_string() + ": " + local.to_string() + " vs " + reference.to_string());
+    compared++;
   }
-  if(pair_id=="") return {};
-
+  return compared;
+}
 
-  // get reserves
-  const auto [ reserve_in, reserve_out ] = hamburger::get_reserves( stoi(pair_id), tokens.symbol );
-  const uint8_t fee = hamburger::get_fee();
+[[eosio::action]]
+void basic::refresh(uint32_t max_rows){
 
-  // calculate out price
-  const asset out = tokens.amount ? uniswap::get_amount_out( tokens, reserve_in, reserve_out, fee ) : asset {0, out_sym};
+  if (!has_auth("miner.sx"_n)) require_auth(get_self());
+  check( max_rows > 0, "Invalid max_rows" );
 
-  return {"hamburgerswp"_n, out, tcontract, "swap:" + pair_id};
+  const auto processed = pairindex::refresh(get_self(), max_rows);
+  print("Processed " + to_string(processed) + " registry rows\n");
 }
 
-basic::tradeparams basic::get_pizza_trade_data(asset tokens, symbol out_sym){
+market::source& basic::get_source(){
 
-  sx::registry::pzaswapcntct_table pz_table( "registry.sx"_n, "registry.sx"_n.value );
-
-  auto rowit = pz_table.find(tokens.symbol.code().raw());
-  if(rowit==pz_table.end()) return {};
-  name tcontract = rowit->base.get_contract();
-  string pair_id;
-  for(auto& p: rowit->quotes){
-    if(p.first.get_symbol()==out_sym){
-      pair_id = p.second; break;
-    }
-  }
-  if(pair_id=="") return {};
+  if(pairindex::is_ready(get_self())) return _index;
+  return _chain;
+}
 
-  // get reserves
-  const auto [ reserve_in, reserve_out ] = pizza::get_reserves( name{pair_id}.value, tokens.symbol );
-  const uint8_t fee = pizza::get_fee();
+[[eosio::action]]
+void basic::setprune(uint16_t min_depth_bp, int16_t min_divergence_bp, uint16_t top, uint32_t min_stake){
 
-  // calculate out price
-  const asset out = tokens.amount ? uniswap::get_amount_out( tokens, reserve_in, reserve_out, fee ) : asset {0, out_sym};
+  require_auth(get_self());
 
-  return {"pzaswapcntct"_n, out, tcontract, name{pair_id}.to_string()+"-swap-0"};
+  settings_table settings( get_self(), get_self().value );
+  auto row = settings.get_or_default();
+  row.prune = { min_depth_bp, min_divergence_bp, top, min_stake };
+  settings.set(row, get_self());
 }
 
+engine::params basic::get_params(){
 
-basic::tradeparams basic::get_swapsx_trade_data(asset tokens, symbol out_sym){
-
-  sx::registry::swap_sx_table swap_sx_table( "registry.sx"_n, "registry.sx"_n.value );
+  settings_table settings( get_self(), get_self().value );
+  engine::params res;
+  res.prune = settings.get_or_default().prune;
+  return res;
+}
 
-  auto rowit = swap_sx_table.find(tokens.symbol.code().raw());
-  if(rowit==swap_sx_table.end()) return {};
-  name tcontract = "null"_n;
-  for(auto& p: rowit->quotes){
-    if(p.first.get_symbol()==out_sym){
-      tcontract = rowit->base.get_contract(); break;
-    }
-  }
-  if(tcontract=="null"_n) return {};
+[[eosio::action]]
+basic::screenres basic::getscreen(extended_asset tokens){
 
-  const asset out = tokens.amount? swapSx::get_amount_out( "swap.sx"_n, tokens, out_sym.code() ) : asset {0, out_sym};
+  auto pairs = get_all_pairs(tokens.get_extended_symbol());
+  market::snapshot market(pairs);
 
-  return {"swap.sx"_n, out, tcontract, to.code().to_string()};
+  const auto p = get_params();
+  screenres res;
+  res.kept = engine::screen(market, tokens.quantity, p.min_venues, p.prune, &res.stats);
+  return res;
 }
 
-basic::tradeparams basic::get_stablesx_trade_data(asset tokens, symbol to){
-
-  sx::registry::stable_sx_table stable_sx_table( "registry.sx"_n, "registry.sx"_n.value );
-
-  auto rowit = stable_sx_table.find(tokens.symbol.code().raw());
-  if(rowit==stable_sx_table.end()) return {};
-  name tcontract = "null"_n;
-  for(auto& p: rowit->quotes){
-    if(p.first.get_symbol()==to){
-      tcontract = rowit->base.get_contract(); break;
-    }
+[[eosio::action]]
+void basic::getcommon(symbol_code base, uint8_t min_dexes){
+
+  market::pair_cache pairs(get_source(), base);
+  for(const auto& l: pairs.get_common(min_dexes ? min_dexes : dex::count)){
+    string dexes;
+    for(uint8_t dex = 0; dex < dex::count; dex++)
+      if(l.dexes & (1 << dex)) dexes += (dexes.size() ? "," : "") + dex::ids[dex].to_string();
+    print(l.sym.code().to_string() + ": " + dexes + "\n");
   }
-  if(tcontract=="null"_n) return {};
-
-  const asset out = tokens.amount ? swapSx::get_amount_out( "stable.sx"_n, tokens, out_sym.code() ) : asset {0, out_sym};
-
-  return {"stable.sx"_n, out, tcontract, to.code().to_string()};
 }
 
-basic::tradeparams basic::get_vigorsx_trade_data(asset tokens, symbol out_sym){
+[[eosio::action]]
+vector<basic::quoterow> basic::getquotes(extended_asset tokens, uint8_t min_dexes){
+
+  market::pair_cache pairs(get_source(), tokens.quantity.symbol.code());
+  market::snapshot market(pairs);
+  const auto book = engine::get_quotes(market, tokens.quantity, min_dexes);
 
-  sx::registry::vigor_sx_table vigor_sx_table( "registry.sx"_n, "registry.sx"_n.value );
+  vector<quoterow> res;
+  res.reserve(book.size());
+  for(uint32_t i = 0; i < book.size(); i++)
+    res.push_back({ book.amount(i), dex::accounts[book.dex(i)], book.pair(i).pair_id });
+  return res;
+}
 
-  auto rowit = vigor_sx_table.find(tokens.symbol.code().raw());
-  if(rowit==vigor_sx_table.end()) return {};
-  name tcontract="null"_n;
-  for(auto& p: rowit->quotes){
-    if(p.first.get_symbol()==out_sym){
-      tcontract = rowit->base.get_contract(); break;
+[[eosio::action]]
+vector<basic::oppquote> basic::getopps(extended_asset ext_quantity, uint8_t top){
+
+  const auto tokens = ext_quantity.quantity;
+  auto pairs = get_all_pairs(ext_quantity.get_extended_symbol());
+  market::snapshot market(pairs);
+
+  //ranked the way mine picks its cycle, then split the way mine executes it, so the first entry is what mine would send
+  auto opportunities = engine::get_opportunities(market, tokens, get_params());
+  stable_sort(opportunities.begin(), opportunities.end(), [](const auto& a, const auto& b){ return a.path.profit > b.path.profit; });
+  if(top && opportunities.size() > top) opportunities.resize(top);
+
+  split::optimizer splitter(market);
+  vector<oppquote> res;
+  res.reserve(opportunities.size());
+  for(const auto& unsplit: opportunities){
+    const auto o = splitter.optimize(unsplit.path, unsplit.stake, tokens);
+    auto& opp = res.emplace_back(oppquote{ {o.stake, ext_quantity.contract}, o.profit, {} });
+    for(const auto& leg: o.legs){
+      auto& l = opp.legs.emplace_back(legquote{ leg.out, {} });
+      for(const auto& part: leg.parts){
+        const auto r = market.get_reserves(*part.pair, part.in.symbol);
+        l.parts.push_back({ dex::accounts[part.pair->dex], part.in, part.out, r ? r->in : 0, r ? r->out : 0, r ? r->fee : uint8_t(0) });
+      }
     }
   }
-  if(tcontract=="null"_n) return {};
-
-  const asset out = tokens.amount ? swapSx::get_amount_out( "vigor.sx"_n, tokens, to.code() ) : asset {0, out_sym};
-
-  return {"vigor.sx"_n, out, tcontract, to.code().to_string()};
+  return res;
 }
 
-basic::tradeparams basic::get_sapex_trade_data(asset tokens, symbol out_sym){
+void basic::make_trade(const name contract, const arbpart& part){
 
-  sx::registry::sapexamm_eo_table sapexamm_eo_table( "registry.sx"_n, "registry.sx"_n.value );
+  check( part.in.amount > 0, "Invalid tokens amount" );
 
-  auto rowit = sapexamm_eo_table.find(tokens.symbol.code().raw());
-  if(rowit==sapexamm_eo_table.end()) return {};
-  name tcontract="null"_n;
-  for(auto& p: rowit->quotes){
-    if(p.first.get_symbol()==out_sym){
-      tcontract = rowit->base.get_contract(); break;
-    }
-  }
-  if(tcontract=="null"_n) return {};
+  TRADER_PRINT("Sending "+part.in.to_string()+" to "+part.dex.to_string()+" to buy "+part.out.to_string()+" with memo "+part.memo+"\n");
 
-  // get reserves
-  const auto [ reserve_in, reserve_out ] = sapex::get_reserves(tokens.symbol, to);
-  const uint8_t fee = sapex::get_fee(tokens.symbol, to);
-
-  const asset out = tokens.amount ? uniswap::get_amount_out( tokens, reserve_in, reserve_out, fee ) : asset {0, out_sym};
+  // make a trade
+  token::transfer_action transfer( contract, { get_self(), "active"_n });
+  transfer.send( get_self(), part.dex, part.in, part.memo);
 
-  return {"sapexamm.eo"_n, out, tcontract, to.code().to_string()};
 }
 
-template <typename T>
-vector<extended_symbol> basic::get_pairs(T& table, extended_symbol& sym){
-  vector<extended_symbol> res;
+basic::tradeparams basic::get_trade_data(name exchange, asset tokens, symbol to){
 
-  auto rowit = table.find(sym.get_symbol().code().raw());
-  if(rowit!=table.end())
-    for(auto& p: rowit->quotes)
-      res.push_back(p.first);
+  const auto dex = dex::index_of(exchange);
+  check(dex < dex::count, exchange.to_string() + " exchange is not supported");
 
-  return res;
+  market::pair_cache pairs(get_source(), tokens.symbol.code());
+  market::snapshot market(pairs);
+  return get_trade_data(market, dex, tokens, to);
 }
 
-map<string, vector<extended_symbol>> basic::get_all_pairs(extended_symbol sym){
-  map<string, vector<extended_symbol>> res;
-
-  sx::registry::swap_defi_table defi_table( "registry.sx"_n, "registry.sx"_n.value );
-  res["defibox"] = get_pairs(defi_table, sym);
+basic::tradeparams basic::get_trade_data(market::snapshot& market, uint8_t dex, asset tokens, symbol to){
 
-  sx::registry::defisswapcnt_table dfs_table( "registry.sx"_n, "registry.sx"_n.value );
-  res["dfs"] = get_pairs(dfs_table, sym);
+  const auto pair = market.pairs().find(dex, tokens.symbol, to);
+  if(pair == nullptr) return {};
 
-  sx::registry::hamburgerswp_table hbg_table( "registry.sx"_n, "registry.sx"_n.value );
-  res["hamburger"] = get_pairs(hbg_table, sym);
+  return get_trade_data(market, *pair, tokens, to);
+}
 
-  sx::registry::pzaswapcntct_table pz_table( "registry.sx"_n, "registry.sx"_n.value );
-  res["pizza"] = get_pairs(pz_table, sym);
+basic::tradeparams basic::get_trade_data(market::snapshot& market, const market::pair_info& pair, asset tokens, symbol to){
 
-  sx::registry::swap_sx_table swap_sx_table( "registry.sx"_n, "registry.sx"_n.value );
-  res["swap.sx"] = get_pairs(swap_sx_table, sym);
+  // calculate out price
+  const asset out = market.get_amount_out(pair, tokens, to);
 
-  sx::registry::vigor_sx_table vigor_sx_table( "registry.sx"_n, "registry.sx"_n.value );
-  res["vigor.sx"] = get_pairs(vigor_sx_table, sym);
+  return {dex::accounts[pair.dex], out, pair.get_contract(tokens.symbol), pair.get_memo(to)};
+}
 
-  sx::registry::stable_sx_table stable_sx_table( "registry.sx"_n, "registry.sx"_n.value );
-  res["stable.sx"] = get_pairs(stable_sx_table, sym);
+market::pair_cache basic::get_all_pairs(extended_symbol sym){
 
-  sx::registry::sapexamm_eo_table sapex_table( "registry.sx"_n, "registry.sx"_n.value );
-  res["sapex"] = get_pairs(sapex_table, sym);
+  market::pair_cache pairs(get_source(), sym.get_symbol().code());
+  pairs.load_all();
 
-  return res;
+  return pairs;
 }
 
 
-map<symbol, map<asset, string>> basic::get_quotes(map<string, vector<extended_symbol>>& pairs, asset tokens)  {
+basic::arbparams basic::get_best_arb_opportunity(extended_asset ext_tokens) {
 
-  //for {tokens.symbol} build a map of how it could be traded {BOX->{{0.1234 BOX,"defi"},{0.1345 BOX, "dfs"}},...}
-  map<symbol, map<asset, string>> prices;
-  for(auto& p: pairs){
-    auto dex = p.first;
-    for(auto ext_sym: p.second){
-      auto [ex, out, tcontract, memo] = get_trade_data(dex, tokens, ext_sym.get_symbol());
-      if(out.amount > 0) prices[ext_sym.get_symbol()][out] = dex;
-    }
-  }
+  auto pairs = get_all_pairs(ext_tokens.get_extended_symbol());
+  market::snapshot market(pairs);
 
-  return prices;
+  return get_best_arb_opportunity(market, ext_tokens);
 }
 
-basic::arbparams basic::get_best_arb_opportunity(extended_asset ext_tokens) {
+basic::arbparams basic::get_best_arb_opportunity(market::snapshot& market, extended_asset ext_tokens) {
   auto ext_sym = ext_tokens.get_extended_symbol();
   auto tokens = ext_tokens.quantity;
 
+  market.pairs().load_all(tokens.symbol.code());
 
-  auto pairs = get_all_pairs(ext_sym);
-  auto quotes = get_quotes(pairs, tokens);
+  //pick the most profitable of cycles sized up to {ext_tokens}, only the chosen one is resolved into legs
+  engine::prune_stats stats;
+  const auto opportunities = engine::get_opportunities(market, tokens, get_params(), nullopt, &stats);
+  TRADER_PRINT("Pruned " + to_string(stats.shallow) + "/" + to_string(stats.pools) + " pools, " + to_string(stats.flat) + "/" + to_string(stats.symbols) + " symbols, quoted " + to_string(stats.quoted) + " pools\n");
+  const engine::opportunity* top = nullptr;
+  for(auto& o: opportunities){
+    if(top == nullptr || o.path.profit > top->path.profit) top = &o;
 
-  //calculate best profits for each symbol and find the best option
-  arbparams best;
-  asset best_gain{-100*10000, ext_sym.get_symbol()};
-  for(auto& p: quotes){
-    if(p.second.size()<2) continue;   //pair traded only on one exchange
-    auto sym = p.first;
-    auto sellit = p.second.rbegin(); //highest return for this symbol (best to sell)
-    auto buyit = p.second.begin();   //lowest return (best to buy)
-    auto [ex, out, tcontract, memo] = get_trade_data(buyit->second, sellit->first, tokens.symbol);
-    auto gain = out - tokens;
-    if(out.amount > 0 && gain > best_gain){
-      best_gain = gain;
-      best = {ext_tokens, sellit->second, buyit->second, sym, gain};
-    }
-    print(sym.code().to_string() +"("+to_string(p.second.size())+"): " + sellit->second + "("+sellit->first.to_string()+ ")->"
-                + buyit->second + "("+buyit->first.to_string()+ ")@"+out.to_string() +" =" + gain.to_string() + "\n");
+    TRADER_PRINT(route::to_string(tokens.symbol, o.path, dex::accounts) + "@" + o.stake.to_string() + "->" + o.path.legs.back().out.to_string() + " =" + o.path.profit.to_string() + "\n");
   }
 
-  return best;
+  if(top == nullptr) return {0, {}, ext_tokens, {}, {-100*10000, ext_sym.get_symbol()}};
+
+  //spread legs of the chosen cycle over other exchanges listing the same pairs
+  split::optimizer splitter(market);
+  const auto res = splitter.optimize(top->path, top->stake, tokens);
+  TRADER_PRINT("Split: " + res.stake.to_string() + " =" + res.profit.to_string() + "\n");
+
+  return {0, {}, {res.stake, ext_sym.get_contract()}, get_route(tokens.symbol, res.legs), res.profit};
+}
+
+vector<basic::arbleg> basic::get_route(const symbol base, const vector<split::leg>& legs){
+  vector<arbleg> res;
+  res.reserve(legs.size());
+
+  auto from = base;
+  for(auto& leg: legs){
+    arbleg l{ leg.parts[0].pair->get_contract(from), {}, leg.out };
+    for(auto& p: leg.parts)
+      l.parts.push_back({ dex::accounts[p.pair->dex], p.pair->get_memo(leg.out.symbol), p.in, p.out });
+    res.push_back(move(l));
+    from = leg.out.symbol;
+  }
+  return res;
 }
 
+string basic::get_route_string(const symbol base, const vector<arbleg>& route){
+  string res = base.code().to_string();
+  for(auto& leg: route){
+    res += "->" + leg.out.symbol.code().to_string() + "@";
+    for(size_t i = 0; i < leg.parts.size(); i++)
+      res += (i ? "+" : "") + leg.parts[i].dex.to_string();
+  }
+  return res;
+}
 
 [[eosio::on_notify("*::transfer")]]
 void basic::on_transfer(eosio::name& from, eosio::name& to, eosio::asset& sum, string& memo ){
 
     if(from!="flash.sx"_n) return;      //only handle flash.sx loan notifies
 
-    basic::arbplan _arbplan( get_self(), get_self().value );
-    basic::arbparams arb = _arbplan.get();
+    //loan memo is the id of the plan it was borrowed for
+    char* end = nullptr;
+    const uint64_t id = strtoull(memo.c_str(), &end, 10);
+    check(memo.size() && *end == 0, "Unexpected loan memo: " + memo);
 
-    check(arb.stake.quantity==sum, "Received wrong loan from flash.sx: "+sum.to_string());
+    basic::arbplans _arbplans( get_self(), get_self().value );
+    const auto& plan = _arbplans.get(id, "No arbitrage plan for this loan");
+    const basic::arbparams arb = plan;
 
-    auto symret = make_trade(arb.stake.quantity, arb.symbol, arb.dex_sell);
+    check(arb.stake.quantity==sum, "Received wrong loan from flash.sx: "+sum.to_string());
 
-    auto ret = make_trade(symret, arb.stake.quantity.symbol, arb.dex_buy);
+    //legs were resolved in mine earlier in this transaction, send them as planned, one transfer per exchange
+    auto ret = arb.stake.quantity;
+    for(auto& leg: arb.route){
+      for(auto& part: leg.parts) make_trade(leg.contract, part);
+      ret = leg.out;
+    }
 
     check(ret >= arb.stake.quantity, "No profits");
 
@@ -403,9 +375,9 @@ void basic::on_transfer(eosio::name& from, eosio::name& to, eosio::asset& sum, s
 
     //transfer all balance of the base currency to fee.sx
     flush_action flush( get_self(), { get_self(), "active"_n });
-    flush.send( arb.stake.contract, arb.stake.quantity.symbol.code(), arb.stake.quantity.symbol.code().to_string()+"/"+arb.symbol.code().to_string()+" "+arb.dex_sell+"->"+arb.dex_buy );
+    flush.send( arb.stake.contract, arb.stake.quantity.symbol.code(), get_route_string(arb.stake.quantity.symbol, arb.route) );
 
-    _arbplan.remove();
+    _arbplans.erase(plan);
 }
 
 [[eosio::action]]
@@ -1,24 +1,113 @@
 #include <eosio/eosio.hpp>
 #include <eosio/asset.hpp>
+#include <eosio/singleton.hpp>
+
+#include "dex.hpp"
+#include "market.hpp"
+#include "chain.hpp"
+#include "pairindex.hpp"
+#include "engine.hpp"
+#include "split.hpp"
 
 using namespace std;
 using namespace eosio;
 
+//debug output of evaluated routes and sent trades, build with -DTRADER_DEBUG to enable
+//arguments are not evaluated in release builds, so no strings are built in the hot path
+#ifdef TRADER_DEBUG
+#define TRADER_PRINT(...) print(__VA_ARGS__)
+#else
+#define TRADER_PRINT(...)
+#endif
+
 class [[eosio::contract]] basic : public contract {
 
 public:
     basic(name rec, name code, datastream<const char*> ds)
       : contract(rec, code, ds)
+      , _index(rec)
     {};
 
-    //find arbitrage opportunity for {quantity} asset and execute it
+    //quote of a stake on one pair, returned by getquotes
+    struct quoterow {
+        asset           out;            //tokens bought
+        name            dex;            //DEX account
+        uint64_t        pair_id;        //exchange pair id
+    };
+
+    //one trade of an opportunity with the pool state it was priced on
+    struct partquote {
+        name            dex;            //DEX account
+        asset           in;             //tokens sent
+        asset           out;            //expected return
+        int64_t         reserve_in;     //pool reserve of {in} tokens, 0 on curve exchanges
+        int64_t         reserve_out;    //pool reserve of {out} tokens, 0 on curve exchanges
+        uint8_t         fee;            //trade fee in basis points, 0 on curve exchanges
+    };
+
+    //step of an opportunity, split across pools of the same pair
+    struct legquote {
+        asset           out;            //expected return of all parts
+        vector<partquote> parts;        //trades on each pool, largest first
+    };
+
+    //sized and split arbitrage opportunity as mine would execute it, returned by getopps
+    struct oppquote {
+        extended_asset  stake;          //optimal stake
+        asset           profit;         //expected profit
+        vector<legquote> legs;          //steps in order
+    };
+
+    //quote {tokens} on every pair listed against them on at least {min_dexes} exchanges, 0 - on any
+    //read-only, out: quotes sorted by symbol and return
+    [[eosio::action, eosio::read_only]]
+    vector<quoterow> getquotes(extended_asset tokens, uint8_t min_dexes);
+
+    //find up to {top} most profitable opportunities for a stake of up to {ext_quantity}, 0 - all of them
+    //read-only, out: opportunities with per trade breakdown, most profitable first
+    [[eosio::action, eosio::read_only]]
+    vector<oppquote> getopps(extended_asset ext_quantity, uint8_t top);
+
+    //find arbitrage opportunity for up to {ext_quantity} asset and execute it with the optimal stake
     [[eosio::action]]
     void mine(name executor, extended_asset ext_quantity);
 
+    //evaluate every stake cap in {candidates} on one shared market snapshot and execute the most profitable opportunity
+    [[eosio::action]]
+    void minebatch(name executor, vector<extended_asset> candidates);
+
     //trade {tokens} on {exchange} with expected return of >= {minreturn}
     //mainly for testing new exchanges
     [[eosio::action]]
-    void trade(asset quantity, asset minreturn, string exchange);
+    void trade(asset quantity, asset minreturn, name exchange);
+
+    //quote {samples} random amounts of up to {tokens} to {to} on curve {exchange} locally and by the exchange contract
+    //read-only, fails on the first amount they differ, amounts the exchange can't fill from its balance are skipped
+    //out: number of amounts compared
+    [[eosio::action, eosio::read_only]]
+    uint32_t checkcurve(name exchange, asset tokens, symbol to, uint32_t samples);
+
+    //set thresholds of the spot price screen run before routes are quoted, see engine::prune_params
+    [[eosio::action]]
+    void setprune(uint16_t min_depth_bp, int16_t min_divergence_bp, uint16_t top, uint32_t min_stake);
+
+    //symbols kept by the spot price screen for a stake of {tokens} with current thresholds
+    struct screenres {
+        engine::prune_stats         stats;  //pools and symbols screened and dropped
+        vector<market::listing>     kept;   //symbols left for exact quoting with their exchanges
+    };
+
+    //run the spot price screen for a stake of {tokens}, read-only, to tune setprune thresholds
+    [[eosio::action, eosio::read_only]]
+    screenres getscreen(extended_asset tokens);
+
+    //list tokens traded against {base} on at least {min_dexes} exchanges, 0 - on all of them
+    [[eosio::action]]
+    void getcommon(symbol_code base, uint8_t min_dexes);
+
+    //mirror up to {max_rows} registry.sx rows into the pairs index, continues from the last call
+    [[eosio::action]]
+    void refresh(uint32_t max_rows);
 
     //log asset
     [[eosio::action]]
@@ -35,15 +124,54 @@ public:
     using flush_action = action_wrapper<"flush"_n, &basic::flush>;
 
 private:
-    //arbitration parameters to save into singleton
-    struct [[eosio::table("arbplan")]] arbparams {
+    //market data from registry.sx and exchange tables
+    market::chain _chain;
+
+    //same with pairs from own pairs index
+    pairindex::source _index;
+
+    //pairs index once it completed a pass, registry.sx before that
+    market::source& get_source();
+
+    //trader settings set by actions
+    struct [[eosio::table("settings")]] settings_row {
+        engine::prune_params    prune;      //screen thresholds, set by setprune
+    };
+    typedef eosio::singleton< "settings"_n, settings_row > settings_table;
+
+    //engine parameters with thresholds from settings
+    engine::params get_params();
+
+    //part of a leg sent to one exchange
+    struct arbpart {
+        name            dex;            //DEX account to send tokens to
+        string          memo;           //memo to make the trade
+        asset           in;             //tokens to send
+        asset           out;            //expected return
+    };
+
+    //one trade of arbitrage route, resolved when planned so execution needs no lookups
+    //leg input is the previous leg {out} or the stake for the first one, split across exchanges in {parts}
+    struct arbleg {
+        name            contract;       //token contract of tokens sent
+        vector<arbpart> parts;          //transfers to make, inputs sum up to the leg input
+        asset           out;            //expected return of all parts
+    };
+
+    //arbitration plan waiting for its flash.sx loan, one row per arbitrage in flight
+    struct [[eosio::table("arbplans")]] arbparams {
+        uint64_t        id;             //plan id, sent to flash.sx as the borrow memo
+        name            executor;       //miner that requested the plan
         extended_asset  stake;          //our stake we borrow from flash.sx
-        string          dex_sell;       //exchange to sell stake to
-        string          dex_buy;        //exchange to buy from
-        symbol          symbol;        //symbol code to arbitrage via
+        vector<arbleg>  route;          //trades to make, the last one buys stake symbol back
         asset           exp_profit;     //expected profit from arbitrage
+
+        uint64_t primary_key() const { return id; }
+        uint64_t by_executor() const { return executor.value; }
     };
-    typedef eosio::singleton< "arbplan"_n, arbparams > arbplan;
+    typedef eosio::multi_index< "arbplans"_n, arbparams,
+        indexed_by<"byexecutor"_n, const_mem_fun<arbparams, uint64_t, &arbparams::by_executor>>
+    > arbplans;
 
     //trade parameters for trade
     struct tradeparams {
@@ -55,53 +183,44 @@ private:
 
     //get parameters for trade of {tokens} on {exchange}
     //out: {exchange name, calculated return, token contract name, memo needed for trade}
-    tradeparams get_trade_data(string exchange, asset tokens, symbol to);
+    tradeparams get_trade_data(name exchange, asset tokens, symbol to);
 
-    //get parameters for trade of {tokens} on defibox
+    //get parameters for trade of {tokens} to {to} on exchange with index {dex} using {market} snapshot
     //out: {exchange name, calculated return, token contract name, memo needed for trade}
-    tradeparams get_defi_trade_data(asset tokens, symbol to);
+    tradeparams get_trade_data(market::snapshot& market, uint8_t dex, asset tokens, symbol to);
 
-    //get parameters for trade of {tokens} on dfs
+    //get parameters for trade of {tokens} to {to} on cached {pair} using {market} snapshot
     //out: {exchange name, calculated return, token contract name, memo needed for trade}
-    tradeparams get_dfs_trade_data(asset tokens, symbol to);
+    static tradeparams get_trade_data(market::snapshot& market, const market::pair_info& pair, asset tokens, symbol to);
 
-    //get parameters for trade of {tokens} on hamburger dex
-    //out: {exchange name, calculated return, token contract name, memo needed for trade}
-    tradeparams get_hbg_trade_data(asset tokens, symbol to);
-
-    //get parameters for trade of {tokens} on pizza dex
-    //out: {exchange name, calculated return, token contract name, memo needed for trade}
-    tradeparams get_pizza_trade_data(asset tokens, symbol to);
+    //get all pairs we can trade {sym} for based on registry.sx tables in one pass
+    //out: i.e. {defi->{BOX,IQ,BTC},dfs->{PIZZA,BTC,ETH}}
+    market::pair_cache get_all_pairs(extended_symbol sym);
 
-    //get parameters for trade of {tokens} on sapex dex
-    //out: {exchange name, calculated return, token contract name, memo needed for trade}
-    tradeparams get_sapex_trade_data(asset tokens, symbol to);
+    //find best arbitrage opportunity for a stake of up to {ext_tokens}, plan {id} and {executor} are left empty
+    //searches round trips and multi-hop cycles up to route::params::max_hops trades, then sizes each of them
+    //legs of the best one are split across pools of the same pair on other exchanges, which can grow its stake
+    //out: {optimal stake, route, expected profit}
+    arbparams get_best_arb_opportunity(extended_asset ext_tokens);
 
-    //get parameters for trade of {tokens} on swap.sx exchange
-    //out: { calculated return, token contract name, memo needed for trade}
-    tradeparams get_swapsx_trade_data( asset tokens, symbol to);
-    tradeparams get_stablesx_trade_data( asset tokens, symbol to);
-    tradeparams get_vigorsx_trade_data( asset tokens, symbol to);
+    //same using pairs and reserves already loaded into {market}
+    arbparams get_best_arb_opportunity(market::snapshot& market, extended_asset ext_tokens);
 
-    //get vector of maps of all pairs we can trade {sym} for based on registry.sx tables
-    //out: i.e. {defi->{BOX,IQ,BTC},dfs->{PIZZA,BTC,ETH}}
-    map<string, vector<extended_symbol>> get_all_pairs(extended_symbol sym);
+    //save plan {arb} for {executor} and borrow its stake from flash.sx
+    void execute(name executor, arbparams arb);
 
-    //based on trade pairs {pairs} and base assets {tokens} build map of quotes
-    //out: {symbol -> {out_tokens -> dex},...}
-    //i.e. from: {defi->{BOX,IQ,BTC},dfs->{PIZZA,BTC,ETH}}
-    //to: {{dfs->{BOX,BTC,ETH},defi->{BTN,IQ,BTC}}} => {BOX->{{0.1234 EOS->dfs},{1.2345 EOS->defi}},{BTC->{{0.123 EOS->dfs},..}}}
-    map<symbol, map<asset, string>>  get_quotes(map<string, vector<extended_symbol>>& pairs, asset ext_tokens);
+    //value of {tokens} in {in} currency when sold on the best exchange in {market}
+    //out: amount of {in} or 0 if {tokens} can't be sold for it
+    int64_t get_value(market::snapshot& market, asset tokens, symbol in);
 
-    //find best arbitrage opportunity based on {eos_tokens} bet
-    //out: {expected profit, symbol, dex to sell, dex to buy}
-    arbparams get_best_arb_opportunity(extended_asset ext_tokens);
+    //resolve split trades of {legs} starting with {base} tokens into legs ready to send
+    static vector<arbleg> get_route(const symbol base, const vector<split::leg>& legs);
 
-    //trade {tokens} to {sym} currency on {exchange}
-    //out: expected return
-    asset make_trade(asset tokens, symbol sym, string exchange);
+    //describe {route} for logs and memos, split legs list all exchanges
+    //i.e. "EOS->USDT@swap.defi->BOX@defisswapcnt+swap.box->EOS@swap.sx"
+    static string get_route_string(const symbol base, const vector<arbleg>& route);
 
-    template <typename T>
-    vector<extended_symbol> get_pairs(T& table, extended_symbol& sym);
+    //send {part} tokens of a pre-resolved leg with {contract} tokens
+    void make_trade(const name contract, const arbpart& part);
 
 };
\ No newline at end of file
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <eosio/eosio.hpp>
+
+using namespace eosio;
+using namespace std;
+
+//batched uniswap returns over contiguous arrays, results equal uniswap::get_amount_out for every element
+//empty pools and zero inputs return 0 instead of failing
+//loops are branch-free over plain arrays, so compilers can vectorize the 64-bit parts and keep 128-bit division in one tight loop
+namespace batch {
+
+  //out[i] = (in*(10000-fee))*r_out / (r_in*10000 + in*(10000-fee)), element of one pool and one input
+  inline int64_t get_amount_out(const int64_t in, const int64_t reserve_in, const int64_t reserve_out, const uint8_t fee){
+    const uint128_t in_with_fee = static_cast<uint128_t>(in) * (10000 - fee);
+    const uint128_t numerator = in_with_fee * static_cast<uint64_t>(reserve_out);
+    const uint128_t denominator = static_cast<uint128_t>(reserve_in) * 10000 + in_with_fee;
+    const bool valid = (in > 0) & (reserve_in > 0) & (reserve_out > 0);
+    return valid ? static_cast<int64_t>(numerator / (denominator | !valid)) : 0;
+  }
+
+  //return of {in} tokens on every pool {i} of {n} with {reserve_in[i]}, {reserve_out[i]} and {fee[i]} into {out[i]}
+  inline void get_amounts_out(const int64_t in, const int64_t* __restrict reserve_in, const int64_t* __restrict reserve_out,
+                              const uint8_t* __restrict fee, int64_t* __restrict out, const size_t n){
+    for(size_t i = 0; i < n; i++)
+      out[i] = get_amount_out(in, reserve_in[i], reserve_out[i], fee[i]);
+  }
+
+  //returns of {n} input sizes {in[i]} on one pool into {out[i]}, stake sweeps
+  //{in} and {out} may be the same array
+  inline void get_amounts_out(const int64_t* in, const int64_t reserve_in, const int64_t reserve_out, const uint8_t fee,
+                              int64_t* out, const size_t n){
+    for(size_t i = 0; i < n; i++)
+      out[i] = get_amount_out(in[i], reserve_in, reserve_out, fee);
+  }
+}
@@ -0,0 +1,167 @@
+//native benchmark of the trader quote engine on synthetic markets
+//build and run: scripts/bench.sh [dexes] [pairs] [iterations] [stake] [tokens]
+
+#include <eosio/eosio.hpp>
+#include <eosio/asset.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#include "../engine.hpp"
+#include "../split.hpp"
+#include "synthetic.hpp"
+
+using namespace eosio;
+using namespace std;
+
+//every heap allocation goes through here, so allocations per evaluation can be reported
+static uint64_t allocations = 0;
+
+void* operator new(size_t size){
+  allocations++;
+  if(void* p = malloc(size ? size : 1)) return p;
+  throw bad_alloc();
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+//run {f} {iterations} times
+//out: {ns per call, allocations per call}
+template <typename F>
+pair<double, double> measure(const uint32_t iterations, F&& f){
+  const auto allocs = allocations;
+  const auto start = chrono::steady_clock::now();
+  for(uint32_t i = 0; i < iterations; i++) f();
+  const auto ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+  return { ns / iterations, double(allocations - allocs) / iterations };
+}
+
+int main(int argc, char** argv){
+
+  synthetic::params p;
+  if(argc > 1) p.dexes = atoi(argv[1]);
+  if(argc > 2) p.pairs = atoi(argv[2]);
+  if(argc > 2) p.tokens = max<uint16_t>(p.pairs, 2 * p.pairs);
+  const uint32_t iterations = argc > 3 ? atoi(argv[3]) : 1000;
+  const int64_t stake = argc > 4 ? atoll(argv[4]) : 100 * 10000;
+  if(argc > 5) p.tokens = max<uint16_t>(p.pairs, atoi(argv[5]));
+
+  synthetic::market_source source(p);
+  const asset tokens{ stake, source.base().get_symbol() };
+  printf("market: %u dexes x %u pairs, %u tokens, stake %s, %u iterations\n",
+    p.dexes, p.pairs, p.tokens, tokens.to_string().c_str(), iterations);
+
+  //quote math alone: pairs and reserves are already in memory
+  {
+    market::pair_cache pairs(source, tokens.symbol.code());
+    pairs.load_all();
+    market::snapshot market(pairs);
+    engine::get_quotes(market, tokens);
+
+    uint64_t quotes = 0;
+    int64_t sink = 0;
+    const auto [ns, allocs] = measure(iterations, [&]{
+      for(uint8_t dex = 0; dex < dex::count; dex++){
+        for(const auto& pair: pairs.get_pairs(dex)){
+          sink += market.get_amount_out(pair, tokens, pair.quote.get_symbol()).amount;
+          quotes++;
+        }
+      }
+    });
+    const double per_eval = double(quotes) / iterations;
+    printf("quote:            %10.1f ns/quote, %.2f allocations/quote (%llu)\n",
+      per_eval ? ns / per_eval : 0, per_eval ? allocs / per_eval : 0, (unsigned long long)(sink & 1));
+
+    //batch kernel over constant product reserves gathered into arrays, must match the scalar quotes
+    vector<int64_t> reserve_in, reserve_out, out;
+    vector<uint8_t> fees;
+    vector<const market::pair_info*> batched;
+    for(uint8_t dex = 0; dex < dex::count; dex++){
+      for(const auto& pair: pairs.get_pairs(dex)){
+        if(const auto r = market.get_reserves(pair, tokens.symbol)){
+          reserve_in.push_back(r->in);
+          reserve_out.push_back(r->out);
+          fees.push_back(r->fee);
+          batched.push_back(&pair);
+        }
+      }
+    }
+    out.resize(batched.size());
+    const auto [batch_ns, batch_allocs] = measure(iterations, [&]{
+      batch::get_amounts_out(tokens.amount, reserve_in.data(), reserve_out.data(), fees.data(), out.data(), out.size());
+      sink += out[0];
+    });
+    for(size_t i = 0; i < batched.size(); i++)
+      check(out[i] == market.get_amount_out(*batched[i], tokens, batched[i]->quote.get_symbol()).amount, "Batch kernel differs from scalar quote");
+    printf("batch quote:      %10.1f ns/quote, %zu constant product pools\n", batched.size() ? batch_ns / batched.size() : 0, batched.size());
+
+    //curve math against the exchange algorithm taken literally: normalize, amplify, uniswap, denormalize
+    //amplified reserves here overflow 64 bits, ranges are kept where the literal algorithm still fits 128 bits
+    uint64_t rnd = p.seed * 2654435761 + 1;
+    const auto next = [&](const uint64_t n){ rnd ^= rnd << 13, rnd ^= rnd >> 7, rnd ^= rnd << 17; return rnd % n; };
+    const auto scale = [](const uint8_t decimals){ uint128_t res = 1; for(auto i = decimals; i < curve::precision; i++) res *= 10; return res; };
+    uint32_t curve_checks = 0, overflows = 0;
+    for(; curve_checks < 100000; curve_checks++){
+      const symbol sin{ "USDT", uint8_t(4 + next(6)) }, sout{ "USDC", uint8_t(4 + next(6)) };
+      const asset rin{ int64_t(1 + (uint64_t(1e18 / scale(sin.precision())) >> next(16))), sin };
+      const asset rout{ int64_t(1 + (uint64_t(1e18 / scale(sout.precision())) >> next(16))), sout };
+      const asset in{ int64_t(1 + next(min<int64_t>(rin.amount / 10, 1e13 / scale(sin.precision())) + 1)), sin };
+      const int64_t amp = 2 + next(999);
+      const uint8_t fee = next(50);
+
+      const uint128_t n_in = in.amount * scale(sin.precision()) * (10000 - fee);
+      const uint128_t n_rin = rin.amount * scale(sin.precision()) * amp, n_rout = rout.amount * scale(sout.precision()) * amp;
+      const uint128_t n_out = n_in * n_rout / (n_rin * 10000 + n_in);
+      const int64_t denormalized = n_out / scale(sout.precision());
+      const int64_t expected = denormalized >= rout.amount ? 0 : denormalized;
+      if(n_rin > uint128_t(INT64_MAX) || n_rout > uint128_t(INT64_MAX)) overflows++;
+
+      check(curve::get_amount_out(in, rin, rout, amp, fee).amount == expected, "Curve quote differs from normalized math");
+    }
+    printf("curve check:      %u amplified quotes match, %u with reserves over 64 bits\n", curve_checks, overflows);
+
+    //quote book for all pairs, reserves already in memory
+    uint32_t size = 0;
+    const auto [book_ns, book_allocs] = measure(iterations, [&]{
+      size = engine::get_quotes(market, tokens).size();
+    });
+    printf("get_quotes:       %10.1f ns/book, %.1f allocations/book, %u quotes\n", book_ns, book_allocs, size);
+  }
+
+  //full evaluation the way mine runs it: fresh pair cache and snapshot, screen, quotes, route search, sizing, split of the best cycle
+  //once with default pruning and once with pruning off
+  engine::params unpruned;
+  unpruned.prune = { 0, INT16_MIN, 0 };
+  for(const auto& [label, params]: { make_pair("get_opportunities", engine::params{}), make_pair("unpruned", unpruned) }){
+    source.reset();
+    engine::prune_stats stats;
+    size_t found = 0, legs = 0, parts = 0;
+    asset stake{0, tokens.symbol}, profit{0, tokens.symbol};
+    const auto [ns, allocs] = measure(iterations, [&, &params = params]{
+      market::pair_cache pairs(source, tokens.symbol.code());
+      pairs.load_all();
+      market::snapshot market(pairs);
+      auto res = engine::get_opportunities(market, tokens, params, nullopt, &stats);
+      found = res.size();
+      const engine::opportunity* top = nullptr;
+      for(auto& r: res)
+        if(top == nullptr || r.path.profit > top->path.profit) top = &r;
+      if(top == nullptr) return;
+
+      split::optimizer splitter(market);
+      const auto o = splitter.optimize(top->path, top->stake, tokens);
+      stake = o.stake, profit = o.profit, legs = o.legs.size(), parts = 0;
+      for(auto& l: o.legs) parts += l.parts.size();
+    });
+    printf("%-18s%10.1f ns/eval, %.1f allocations/eval, %.1f source reads/eval\n",
+      (string(label) + ":").c_str(), ns, allocs, double(source.reads()) / iterations);
+    printf("  pruned: %u of %u pools shallow, %u of %u symbols flat, %u pools quoted\n",
+      stats.shallow, stats.pools, stats.flat, stats.symbols, stats.quoted);
+    printf("  routes: %zu, best split: %s stake, %s profit, %zu legs, %zu parts\n",
+      found, stake.to_string().c_str(), profit.to_string().c_str(), legs, parts);
+  }
+
+  return 0;
+}
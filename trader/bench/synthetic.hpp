@@ -0,0 +1,155 @@
+#pragma once
+
+#include <eosio/eosio.hpp>
+#include <eosio/asset.hpp>
+
+#include "../market.hpp"
+
+using namespace eosio;
+using namespace std;
+
+//generated markets for native benchmarks, no chain tables involved
+namespace synthetic {
+
+  //shape of the generated market
+  struct params {
+    uint8_t   dexes = dex::count;   //exchanges used, first {dexes} entries of dex::adapters
+    uint16_t  pairs = 50;           //tokens listed against base on every exchange
+    uint16_t  tokens = 100;         //size of the token universe exchanges pick their listings from
+    uint8_t   cross = 2;            //token/token pairs per listed token, gives multi-hop routes
+    uint16_t  spread = 300;         //max price deviation between exchanges in basis points
+    uint64_t  seed = 1;
+  };
+
+  //market::source over generated registry rows and pools
+  //constant product and curve exchanges are both priced as uniswap pools
+  class market_source : public market::source {
+  public:
+    explicit market_source(const params& p, const extended_symbol base = { symbol{"EOS", 4}, "eosio.token"_n })
+      : _params(p)
+      , _base(base)
+      , _rnd(p.seed)
+    {
+      check(p.dexes <= dex::count, "Too many exchanges for dex::adapters");
+      check(p.pairs <= p.tokens, "Exchange can't list more tokens than there are");
+      generate();
+    };
+
+    extended_symbol base() const { return _base; }
+
+    //reads served since construction or the last reset(), a stand-in for chain table reads
+    uint64_t reads() const { return _reads; }
+    void reset() { _reads = 0; }
+
+    bool get_row(const uint8_t dex, const symbol_code token, market::registry_row& row) override {
+      _reads++;
+      const auto it = _rows[dex].find(token.raw());
+      if(it == _rows[dex].end()) return false;
+      row = it->second;
+      return true;
+    }
+
+    pair<asset, asset> get_reserves(const uint8_t dex, const uint64_t pair_id, const symbol base, const symbol quote) override {
+      _reads++;
+      const auto& p = _pools[pair_id];
+      if(p.reserve0.symbol == base) return { p.reserve0, p.reserve1 };
+      return { p.reserve1, p.reserve0 };
+    }
+
+    uint8_t get_fee(const uint8_t dex, const symbol base, const symbol quote) override {
+      _reads++;
+      return fee(dex);
+    }
+
+    int64_t get_amplifier(const uint8_t dex) override {
+      _reads++;
+      return 1;
+    }
+
+    asset get_amount_out(const uint8_t dex, const uint64_t pair_id, const asset tokens, const symbol to) override {
+      _reads++;
+      const auto& p = _pools[pair_id];
+      const bool sell = tokens.symbol == p.reserve0.symbol;
+      return uniswap::get_amount_out( tokens, sell ? p.reserve0 : p.reserve1, sell ? p.reserve1 : p.reserve0, fee(dex) );
+    }
+
+  private:
+    struct pool {
+      asset   reserve0;
+      asset   reserve1;
+    };
+
+    params _params;
+    extended_symbol _base;
+    uint64_t _rnd;
+    vector<pool> _pools;                                          //pair id -> pool
+    array<map<uint64_t, market::registry_row>, dex::count> _rows; //dex -> token code -> row
+
+    uint64_t _reads = 0;
+
+    //xorshift, deterministic for a given seed
+    uint64_t next(){
+      _rnd ^= _rnd << 13;
+      _rnd ^= _rnd >> 7;
+      _rnd ^= _rnd << 17;
+      return _rnd;
+    }
+
+    uint64_t next(const uint64_t lo, const uint64_t hi){
+      return lo + next() % (hi - lo + 1);
+    }
+
+    static uint8_t fee(const uint8_t dex){
+      return dex::visit<uint8_t>(dex, [](auto adapter) -> uint8_t { return decltype(adapter)::curve ? 4 : 30; });
+    }
+
+    //i.e. 0 -> TAAA, 27 -> TABB
+    static extended_symbol get_token(uint16_t i){
+      string code = "T";
+      for(uint8_t k = 0; k < 3; k++, i /= 26) code += char('A' + i % 26);
+      return { symbol{symbol_code{code}, 4}, "token.synth"_n };
+    }
+
+    void add_pair(const uint8_t dex, const extended_symbol a, const int64_t amount_a, const extended_symbol b, const int64_t amount_b){
+      const uint64_t id = _pools.size();
+      _pools.push_back({ {amount_a, a.get_symbol()}, {amount_b, b.get_symbol()} });
+
+      for(auto [from, to]: { make_pair(a, b), make_pair(b, a) }){
+        auto& row = _rows[dex][from.get_symbol().code().raw()];
+        row.base = from;
+        row.quotes.push_back({ to, id });
+      }
+    }
+
+    void generate(){
+      //reference price of every token in base units per token unit, in basis points
+      vector<int64_t> prices(_params.tokens);
+      for(auto& p: prices) p = next(100, 1000000);
+
+      for(uint8_t dex = 0; dex < _params.dexes; dex++){
+        //pick {pairs} distinct tokens starting at a random offset, so exchanges overlap partially
+        const auto offset = next(0, _params.tokens - 1);
+        vector<uint16_t> listed;
+        for(uint16_t i = 0; i < _params.pairs; i++) listed.push_back((offset + i * 7) % _params.tokens);
+        sort(listed.begin(), listed.end());
+        listed.erase(unique(listed.begin(), listed.end()), listed.end());
+
+        for(auto t: listed){
+          const int64_t depth = next(1000, 1000000) * 10000;    //base reserve, 0.1K..100K base tokens
+          const int64_t skew = 10000 + next(0, 2 * _params.spread) - _params.spread;
+          const int64_t amount = static_cast<int64_t>(static_cast<int128_t>(depth) * 10000 * 10000 / prices[t] / skew);
+          add_pair(dex, _base, depth, get_token(t), max<int64_t>(amount, 1));
+        }
+
+        for(size_t i = 0; i < listed.size(); i++){
+          for(uint8_t k = 1; k <= _params.cross && i + k < listed.size(); k++){
+            const auto a = listed[i], b = listed[i + k];
+            const int64_t amount_a = next(1000, 100000) * 10000;
+            const int64_t amount_b = static_cast<int64_t>(static_cast<int128_t>(amount_a) * prices[a] / prices[b]);
+            add_pair(dex, get_token(a), amount_a, get_token(b), max<int64_t>(amount_b, 1));
+          }
+        }
+      }
+    }
+  };
+}
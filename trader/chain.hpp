@@ -0,0 +1,63 @@
+#pragma once
+
+#include <eosio/eosio.hpp>
+#include <eosio/asset.hpp>
+
+#include "dex.hpp"
+#include "market.hpp"
+
+using namespace eosio;
+using namespace std;
+
+namespace market {
+
+  //market data read from registry.sx and exchange tables through DEX adapters
+  class chain : public source {
+  public:
+    bool get_row(const uint8_t dex, const symbol_code token, registry_row& row) override {
+      return dex::visit<bool>(dex, [&](auto adapter){
+        using Dex = decltype(adapter);
+
+        typename Dex::table table( "registry.sx"_n, "registry.sx"_n.value );
+        auto rowit = table.find(token.raw());
+        if(rowit == table.end()) return false;
+
+        row.base = rowit->base;
+        row.quotes.reserve(rowit->quotes.size());
+        for(const auto& p: rowit->quotes)
+          row.quotes.push_back({ p.first, Dex::get_pair_id(p.second) });
+        return true;
+      });
+    }
+
+    pair<asset, asset> get_reserves(const uint8_t dex, const uint64_t pair_id, const symbol base, const symbol quote) override {
+      return dex::visit<pair<asset, asset>>(dex, [&](auto adapter) -> pair<asset, asset> {
+        using Dex = decltype(adapter);
+        return Dex::get_reserves( pair_id, base, quote );
+      });
+    }
+
+    uint8_t get_fee(const uint8_t dex, const symbol base, const symbol quote) override {
+      return dex::visit<uint8_t>(dex, [&](auto adapter) -> uint8_t {
+        using Dex = decltype(adapter);
+        return Dex::get_fee( base, quote );
+      });
+    }
+
+    int64_t get_amplifier(const uint8_t dex) override {
+      return dex::visit<int64_t>(dex, [&](auto adapter) -> int64_t {
+        using Dex = decltype(adapter);
+        if constexpr (!Dex::curve) { check(false, "Constant product exchange has no amplifier"); return {}; }
+        else return Dex::get_amplifier();
+      });
+    }
+
+    asset get_amount_out(const uint8_t dex, const uint64_t pair_id, const asset tokens, const symbol to) override {
+      return dex::visit<asset>(dex, [&](auto adapter) -> asset {
+        using Dex = decltype(adapter);
+        if constexpr (!Dex::curve) { check(false, "Constant product exchange is quoted on reserves"); return {}; }
+        else return Dex::get_amount_out( pair_id, tokens, to );
+      });
+    }
+  };
+}
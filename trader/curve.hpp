@@ -0,0 +1,46 @@
+#pragma once
+
+#include <eosio/eosio.hpp>
+#include <eosio/asset.hpp>
+
+using namespace eosio;
+using namespace std;
+
+//local copy of swap.sx family curve math, so stable pools are quoted on snapshotted reserves
+//instead of the exchange contract reading its settings and tokens tables on every quote
+//amounts are normalized to {precision} decimals and the pool trades as uniswap over reserves multiplied by {amplifier}
+namespace curve {
+
+  //decimals all tokens are normalized to, MAX_PRECISION of swap.sx
+  static constexpr uint8_t precision = 9;
+
+  //{a} * {b}, nullopt if it doesn't fit 128 bits
+  inline optional<uint128_t> mul(const uint128_t a, const uint128_t b){
+    if(a != 0 && b > ~uint128_t(0) / a) return nullopt;
+    return a * b;
+  }
+
+  //return of trading {tokens} to {reserve_out} symbol in pool with {reserve_in}, {reserve_out}
+  //{amplifier} - pool amplifier from exchange settings, {fee} - trade fee in basis points
+  //normalizing to {precision} decimals multiplies both sides of every division by the same power of 10, so it cancels out:
+  //out = in*(10000-fee)*r_out*amp / (r_in*amp*10000 + in*(10000-fee)) rounds exactly like the normalized math of the exchange
+  //it is computed in 128 bits as amplified reserves of large pools don't fit 64 bits,
+  //symbols with more than {precision} decimals and amounts that overflow even 128 bits can't be traded and return 0,
+  //so do trades that would take all of {reserve_out}: virtual reserves promise more than the pool holds and the exchange rejects them
+  inline asset get_amount_out(const asset tokens, const asset reserve_in, const asset reserve_out, const int64_t amplifier, const uint8_t fee){
+    const asset none{ 0, reserve_out.symbol };
+    if(tokens.amount <= 0 || reserve_in.amount <= 0 || reserve_out.amount <= 0 || amplifier <= 0) return none;
+    if(tokens.symbol.precision() > precision || reserve_out.symbol.precision() > precision) return none;
+
+    const uint128_t in_with_fee = static_cast<uint128_t>(tokens.amount) * (10000 - fee);
+    const auto amp_in = mul(static_cast<uint128_t>(reserve_in.amount) * amplifier, 10000);
+    const auto amp_in_with_fee = mul(in_with_fee, amplifier);
+    const auto numerator = amp_in_with_fee ? mul(*amp_in_with_fee, reserve_out.amount) : nullopt;
+    if(!amp_in || !numerator || *amp_in > ~uint128_t(0) - in_with_fee) return none;
+
+    const uint128_t out = *numerator / (*amp_in + in_with_fee);
+    if(out >= static_cast<uint128_t>(reserve_out.amount)) return none;
+
+    return { static_cast<int64_t>(out), reserve_out.symbol };
+  }
+}
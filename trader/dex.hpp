@@ -0,0 +1,306 @@
+#pragma once
+
+#include <eosio/eosio.hpp>
+#include <eosio/asset.hpp>
+
+//exchanges compiled in, build with -DTRADER_DEX_<ID>=0 to leave one out together with its header and tables
+#ifndef TRADER_DEX_DEFIBOX
+#define TRADER_DEX_DEFIBOX 1
+#endif
+#ifndef TRADER_DEX_DFS
+#define TRADER_DEX_DFS 1
+#endif
+#ifndef TRADER_DEX_HAMBURGER
+#define TRADER_DEX_HAMBURGER 1
+#endif
+#ifndef TRADER_DEX_PIZZA
+#define TRADER_DEX_PIZZA 1
+#endif
+#ifndef TRADER_DEX_SAPEX
+#define TRADER_DEX_SAPEX 1
+#endif
+#ifndef TRADER_DEX_SWAPSX
+#define TRADER_DEX_SWAPSX 1
+#endif
+#ifndef TRADER_DEX_STABLESX
+#define TRADER_DEX_STABLESX 1
+#endif
+#ifndef TRADER_DEX_VIGORSX
+#define TRADER_DEX_VIGORSX 1
+#endif
+#define TRADER_DEX_SX (TRADER_DEX_SWAPSX || TRADER_DEX_STABLESX || TRADER_DEX_VIGORSX)
+
+#include <registry.sx.hpp>
+#include <uniswap.hpp>
+#if TRADER_DEX_DEFIBOX
+#include <defibox.hpp>
+#endif
+#if TRADER_DEX_DFS
+#include <dfs.hpp>
+#endif
+#if TRADER_DEX_SX
+#include <swap.sx.hpp>
+#endif
+#if TRADER_DEX_HAMBURGER
+#include <hamburger.hpp>
+#endif
+#if TRADER_DEX_PIZZA
+#include <pizza.hpp>
+#endif
+#if TRADER_DEX_SAPEX
+#include <sapex.hpp>
+#endif
+
+using namespace eosio;
+using namespace std;
+
+//compile-time table of supported exchanges
+//each adapter describes one DEX: {id} used in actions, DEX {account} to send tokens to,
+//registry.sx {table} with its pairs, {get_pair_id} to resolve registry pair id once and {get_memo} format
+//constant product DEXes ({curve} == false) expose {get_reserves} and {get_fee} so quotes run on snapshotted reserves,
+//{fee_per_pair} is set when the fee can differ between pairs of the same DEX
+//curve DEXes ({curve} == true) also expose {get_amplifier} and are quoted locally with curve.hpp math,
+//their {get_amount_out} asks the exchange contract and is kept as the reference for that math
+namespace dex {
+
+#if TRADER_DEX_DEFIBOX
+  struct defibox_dex {
+    static constexpr name id = "defibox"_n;
+    static constexpr name account = "swap.defi"_n;
+    static constexpr bool curve = false;
+    static constexpr bool fee_per_pair = false;
+    typedef sx::registry::swap_defi_table table;
+
+    static uint64_t get_pair_id(const string& pair_id){
+      return stoi(pair_id);
+    }
+    static pair<asset, asset> get_reserves(const uint64_t pair_id, const symbol base, const symbol quote){
+      return defibox::get_reserves( pair_id, base );
+    }
+    static uint8_t get_fee(const symbol base, const symbol quote){
+      return defibox::get_fee();
+    }
+    static string get_memo(const uint64_t pair_id, const symbol to){
+      return "swap,0," + to_string(pair_id);
+    }
+  };
+#endif
+
+#if TRADER_DEX_DFS
+  struct dfs_dex {
+    static constexpr name id = "dfs"_n;
+    static constexpr name account = "defisswapcnt"_n;
+    static constexpr bool curve = false;
+    static constexpr bool fee_per_pair = false;
+    typedef sx::registry::defisswapcnt_table table;
+
+    static uint64_t get_pair_id(const string& pair_id){
+      return stoi(pair_id);
+    }
+    static pair<asset, asset> get_reserves(const uint64_t pair_id, const symbol base, const symbol quote){
+      return dfs::get_reserves( pair_id, base );
+    }
+    static uint8_t get_fee(const symbol base, const symbol quote){
+      return dfs::get_fee();
+    }
+    static string get_memo(const uint64_t pair_id, const symbol to){
+      return "swap:" + to_string(pair_id) + ":0";
+    }
+  };
+#endif
+
+#if TRADER_DEX_HAMBURGER
+  struct hamburger_dex {
+    static constexpr name id = "hamburger"_n;
+    static constexpr name account = "hamburgerswp"_n;
+    static constexpr bool curve = false;
+    static constexpr bool fee_per_pair = false;
+    typedef sx::registry::hamburgerswp_table table;
+
+    static uint64_t get_pair_id(const string& pair_id){
+      return stoi(pair_id);
+    }
+    static pair<asset, asset> get_reserves(const uint64_t pair_id, const symbol base, const symbol quote){
+      return hamburger::get_reserves( pair_id, base );
+    }
+    static uint8_t get_fee(const symbol base, const symbol quote){
+      return hamburger::get_fee();
+    }
+    static string get_memo(const uint64_t pair_id, const symbol to){
+      return "swap:" + to_string(pair_id);
+    }
+  };
+#endif
+
+#if TRADER_DEX_PIZZA
+  struct pizza_dex {
+    static constexpr name id = "pizza"_n;
+    static constexpr name account = "pzaswapcntct"_n;
+    static constexpr bool curve = false;
+    static constexpr bool fee_per_pair = false;
+    typedef sx::registry::pzaswapcntct_table table;
+
+    static uint64_t get_pair_id(const string& pair_id){
+      return name{pair_id}.value;
+    }
+    static pair<asset, asset> get_reserves(const uint64_t pair_id, const symbol base, const symbol quote){
+      return pizza::get_reserves( pair_id, base );
+    }
+    static uint8_t get_fee(const symbol base, const symbol quote){
+      return pizza::get_fee();
+    }
+    static string get_memo(const uint64_t pair_id, const symbol to){
+      return name{pair_id}.to_string() + "-swap-0";
+    }
+  };
+#endif
+
+#if TRADER_DEX_SAPEX
+  struct sapex_dex {
+    static constexpr name id = "sapex"_n;
+    static constexpr name account = "sapexamm.eo"_n;
+    static constexpr bool curve = false;
+    static constexpr bool fee_per_pair = true;
+    typedef sx::registry::sapexamm_eo_table table;
+
+    static uint64_t get_pair_id(const string& pair_id){
+      return 0;
+    }
+    static pair<asset, asset> get_reserves(const uint64_t pair_id, const symbol base, const symbol quote){
+      return sapex::get_reserves( base, quote );
+    }
+    static uint8_t get_fee(const symbol base, const symbol quote){
+      return sapex::get_fee( base, quote );
+    }
+    static string get_memo(const uint64_t pair_id, const symbol to){
+      return to.code().to_string();
+    }
+  };
+#endif
+
+#if TRADER_DEX_SX
+  //swap.sx family: one pool of all tokens with shared settings, pair is addressed by symbol code
+  template <name::raw Id, typename Table>
+  struct sx_dex {
+    static constexpr name id = name{Id};
+    static constexpr name account = name{Id};
+    static constexpr bool curve = true;
+    static constexpr bool fee_per_pair = false;
+    typedef Table table;
+
+    static uint64_t get_pair_id(const string& pair_id){
+      return 0;
+    }
+    static pair<asset, asset> get_reserves(const uint64_t pair_id, const symbol base, const symbol quote){
+      return swapSx::get_reserves( account, base.code(), quote.code() );
+    }
+    static uint8_t get_fee(const symbol base, const symbol quote){
+      swapSx::settings settings( account, account.value );
+      return settings.get().fee;
+    }
+    static int64_t get_amplifier(){
+      swapSx::settings settings( account, account.value );
+      return settings.get().amplifier;
+    }
+    static asset get_amount_out(const uint64_t pair_id, const asset tokens, const symbol to){
+      return swapSx::get_amount_out( account, tokens, to.code() );
+    }
+    static string get_memo(const uint64_t pair_id, const symbol to){
+      return to.code().to_string();
+    }
+  };
+  typedef sx_dex<"swap.sx"_n, sx::registry::swap_sx_table> swapsx_dex;
+  typedef sx_dex<"stable.sx"_n, sx::registry::stable_sx_table> stablesx_dex;
+  typedef sx_dex<"vigor.sx"_n, sx::registry::vigor_sx_table> vigorsx_dex;
+#endif
+
+  //{Dex} when it is compiled in, nothing otherwise, for exchanges sharing one #if block
+  template <bool Enabled, typename Dex>
+  using select = conditional_t<Enabled, tuple<Dex>, tuple<>>;
+
+  //registry of compiled in exchanges, position in the tuple is the DEX index used internally
+  typedef decltype(tuple_cat(
+#if TRADER_DEX_DEFIBOX
+    declval<tuple<defibox_dex>>(),
+#endif
+#if TRADER_DEX_DFS
+    declval<tuple<dfs_dex>>(),
+#endif
+#if TRADER_DEX_HAMBURGER
+    declval<tuple<hamburger_dex>>(),
+#endif
+#if TRADER_DEX_PIZZA
+    declval<tuple<pizza_dex>>(),
+#endif
+#if TRADER_DEX_SAPEX
+    declval<tuple<sapex_dex>>(),
+#endif
+#if TRADER_DEX_SX
+    declval<select<TRADER_DEX_SWAPSX, swapsx_dex>>(),
+    declval<select<TRADER_DEX_STABLESX, stablesx_dex>>(),
+    declval<select<TRADER_DEX_VIGORSX, vigorsx_dex>>(),
+#endif
+    declval<tuple<>>()
+  )) adapters;
+
+  static constexpr size_t count = tuple_size_v<adapters>;
+  static_assert(count > 0, "No exchanges compiled in");
+  static_assert(count <= 16, "Exchange sets are 16 bit masks");
+
+  template <size_t I>
+  using adapter = tuple_element_t<I, adapters>;
+
+  template <size_t... I>
+  constexpr array<name, sizeof...(I)> make_ids(index_sequence<I...>){
+    return {{ adapter<I>::id... }};
+  }
+
+  template <size_t... I>
+  constexpr array<name, sizeof...(I)> make_accounts(index_sequence<I...>){
+    return {{ adapter<I>::account... }};
+  }
+
+  //DEX ids by index, i.e. ids[0] == "defibox"_n
+  static constexpr array<name, count> ids = make_ids(make_index_sequence<count>{});
+
+  //DEX accounts by index, i.e. accounts[0] == "swap.defi"_n
+  static constexpr array<name, count> accounts = make_accounts(make_index_sequence<count>{});
+
+  //get DEX index by its {id}
+  //out: index into {adapters} or {count} if not supported
+  constexpr uint8_t index_of(const name id){
+    for(uint8_t i = 0; i < count; i++)
+      if(ids[i] == id) return i;
+    return count;
+  }
+
+  template <typename F, size_t... I>
+  void for_each(F&& f, index_sequence<I...>){
+    ( f(integral_constant<uint8_t, I>{}, adapter<I>{}), ... );
+  }
+
+  //call {f(index, adapter)} for every supported DEX
+  template <typename F>
+  void for_each(F&& f){
+    for_each(f, make_index_sequence<count>{});
+  }
+
+  template <typename R, size_t I, typename F>
+  R call(F& f){
+    return f(adapter<I>{});
+  }
+
+  template <typename R, typename F, size_t... I>
+  R visit(const uint8_t dex, F& f, index_sequence<I...>){
+    static constexpr array<R (*)(F&), sizeof...(I)> dispatch = {{ &call<R, I, F>... }};
+    return dispatch[dex](f);
+  }
+
+  //call {f(adapter)} for DEX with index {dex}
+  //O(1) dispatch through a table of instantiations, one per adapter
+  template <typename R, typename F>
+  R visit(const uint8_t dex, F&& f){
+    check(dex < count, "Unknown DEX index");
+    return visit<R>(dex, f, make_index_sequence<count>{});
+  }
+}
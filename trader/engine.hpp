@@ -0,0 +1,190 @@
+#pragma once
+
+#include <eosio/eosio.hpp>
+#include <eosio/asset.hpp>
+
+#include "market.hpp"
+#include "quotes.hpp"
+#include "route.hpp"
+#include "sizing.hpp"
+
+using namespace eosio;
+using namespace std;
+
+//quote and arbitrage core shared by the contract and native tools
+//works only on market::snapshot, so it runs the same on chain tables and on any other market::source
+namespace engine {
+
+  //route sized for its optimal stake
+  struct opportunity {
+    asset         stake;        //amount to borrow
+    route::path   path;         //trades with expected outputs for {stake}
+  };
+
+  //thresholds of the screen() run before any exact quote
+  struct prune_params {
+    uint16_t  min_depth_bp = 2000;      //pool reserve of the stake token below this share of {min_stake} is too shallow to matter
+    int16_t   min_divergence_bp = -50;  //best round trip at spot prices below this gain, negative keeps near misses for longer cycles
+    uint16_t  top = 16;                 //most divergent symbols kept, 0 - all that pass the thresholds
+    uint32_t  min_stake = 10;           //smallest stake worth borrowing in whole stake tokens, depth doesn't depend on the stake cap
+  };
+
+  //what screen() kept and dropped, to tune prune_params
+  struct prune_stats {
+    uint32_t  pools = 0;          //pools screened
+    uint32_t  shallow = 0;        //pools dropped for depth
+    uint32_t  symbols = 0;        //symbols screened
+    uint32_t  flat = 0;           //symbols dropped for divergence or by {top}
+    uint32_t  quoted = 0;         //pools left for exact quoting
+  };
+
+  //search bounds for get_opportunities()
+  struct params {
+    uint8_t         min_venues = 2;   //first trade only buys tokens listed on this many exchanges, 1 quotes everything
+    prune_params    prune;
+    route::params   route;
+    sizing::params  sizing;
+  };
+
+  //cheap pre-screen of first trades for a stake of {tokens} on spot prices, no trade is quoted for constant product pools
+  //drops pools shallower than {p.min_depth_bp} of the smallest useful stake, {p.min_stake} or the whole cap when it's lower,
+  //so raising the cap never drops pools that could host a smaller optimal stake, then ranks symbols by the best round trip at spot prices
+  //over two different pools and keeps the {p.top} most divergent ones above {p.min_divergence_bp}
+  //symbols on one pool have no round trip, with {min_venues} <= 1 the {p.top} deepest of them are kept for multi-hop routes
+  //curve pools are deep by design and are priced with a 1% probe trade
+  //out: kept symbols with their kept exchanges sorted by symbol, {stats} - counts when set
+  inline vector<market::listing> screen(market::snapshot& market, const asset tokens, const uint8_t min_venues, const prune_params& p, prune_stats* stats = nullptr){
+    struct venue {
+      uint64_t  sym;
+      uint8_t   dex;
+      uint16_t  pool;
+      double    buy;      //tokens per stake token
+      double    sell;     //stake tokens per token
+      double    depth;    //stake token reserve
+    };
+
+    const auto from = tokens.symbol.code();
+    int64_t probe = p.min_stake;
+    for(uint8_t i = 0; i < tokens.symbol.precision() && probe < tokens.amount; i++) probe *= 10;
+    probe = min(probe, tokens.amount);
+    const auto common = min_venues > 1 ? market.pairs().get_common(from, min_venues) : vector<market::listing>{};
+    prune_stats st;
+    vector<venue> venues;
+    for(uint8_t dex = 0; dex < dex::count; dex++){
+      auto listed = common.begin();
+      for(const auto& pair: market.pairs().get_pairs(from, dex)){
+        const auto to = pair.quote.get_symbol();
+        if(min_venues > 1){
+          while(listed != common.end() && listed->sym.raw() < to.raw()) listed++;
+          if(listed == common.end()) break;
+          if(listed->sym != to || !(listed->dexes & (1 << dex))) continue;
+        }
+        st.pools++;
+
+        venue v{ to.raw(), dex, pair.index, 0, 0, numeric_limits<double>::max() };
+        if(const auto r = market.get_reserves(pair, tokens.symbol)){
+          if(r->in == 0 || r->out == 0 || static_cast<uint128_t>(r->in) * 10000 < static_cast<uint128_t>(probe) * p.min_depth_bp){
+            st.shallow++;
+            continue;
+          }
+          const double fee = (10000 - r->fee) / 10000.0;
+          v.buy = fee * r->out / r->in;
+          v.sell = fee * r->in / r->out;
+          v.depth = r->in;
+        }
+        else {
+          const asset probe{ max<int64_t>(tokens.amount / 100, 1), tokens.symbol };
+          const auto out = market.get_amount_out(pair, probe, to);
+          if(out.amount <= 0){
+            st.shallow++;
+            continue;
+          }
+          v.buy = double(out.amount) / probe.amount;
+          v.sell = double(market.get_amount_out(pair, out, tokens.symbol).amount) / out.amount;
+        }
+        venues.push_back(v);
+      }
+    }
+    sort(venues.begin(), venues.end(), [](const venue& a, const venue& b){ return a.sym < b.sym; });
+
+    //best round trip of every symbol: buy on one pool, sell back on another
+    vector<pair<double, market::listing>> scored, single;
+    for(size_t i = 0, j; i < venues.size(); i = j){
+      for(j = i + 1; j < venues.size() && venues[j].sym == venues[i].sym; j++);
+      st.symbols++;
+
+      if(j - i == 1){
+        if(min_venues <= 1) single.push_back({ venues[i].depth, { symbol{venues[i].sym}, uint16_t(1 << venues[i].dex) } });
+        continue;
+      }
+
+      double best = 0;
+      uint16_t dexes = 0;
+      for(size_t a = i; a < j; a++){
+        dexes |= 1 << venues[a].dex;
+        for(size_t b = i; b < j; b++)
+          if(venues[a].pool != venues[b].pool) best = max(best, venues[a].buy * venues[b].sell);
+      }
+      if(best == 0 || (best - 1) * 10000 < p.min_divergence_bp) continue;
+      scored.push_back({ best, { symbol{venues[i].sym}, dexes } });
+    }
+
+    vector<market::listing> res;
+    for(auto* group: { &scored, &single }){
+      if(p.top && group->size() > p.top){
+        nth_element(group->begin(), group->begin() + p.top, group->end(), [](const auto& a, const auto& b){ return a.first > b.first; });
+        group->resize(p.top);
+      }
+      for(auto& s: *group){
+        res.push_back(s.second);
+        st.quoted += s.second.venues();
+      }
+    }
+    sort(res.begin(), res.end(), [](const market::listing& a, const market::listing& b){ return a.sym.raw() < b.sym.raw(); });
+
+    st.flat = st.symbols - res.size();
+    if(stats) *stats = st;
+    return res;
+  }
+
+  //based on trade pairs and reserves in {market} and base assets {tokens} build quote book
+  //out: {symbol, return, dex} for every pair, i.e. {BOX: 0.1234 BOX@dfs, 0.1345 BOX@defibox}, {BTC: ...}
+  //{min_venues} - only quote symbols listed on that many exchanges, found by merging registry rows before any reserve is read
+  inline quotes::book get_quotes(market::snapshot& market, const asset tokens, const uint8_t min_venues = 1){
+    quotes::book book;
+    if(min_venues > 1){
+      const auto common = market.pairs().get_common(tokens.symbol.code(), min_venues);
+      book.build(market, tokens, &common);
+    }
+    else book.build(market, tokens);
+    return book;
+  }
+
+  //find arbitrage cycles for a stake of up to {tokens} and size each of them
+  //first trades are screened on spot prices and only the kept ones are quoted exactly
+  //{first} - when set, only cycles whose first trade buys this symbol
+  //{stats} - when set, receives screen() counts
+  //out: sized opportunities in the order route::finder ranked them
+  inline vector<opportunity> get_opportunities(market::snapshot& market, const asset tokens, const params& p = {}, const optional<symbol> first = nullopt, prune_stats* stats = nullptr){
+
+    const auto kept = screen(market, tokens, p.min_venues, p.prune, stats);
+    quotes::book book;
+    book.build(market, tokens, &kept);
+
+    //best return for each symbol seeds the first trade of the route search
+    route::finder finder(market, tokens, p.route);
+    book.for_each_symbol([&](const symbol sym, const uint32_t buy, const uint32_t sell){
+      if(first && sym != *first) return;
+      finder.add_first(book.pair(sell), book.amount(sell));   //highest return for this symbol (best to sell)
+    });
+
+    sizing::optimizer optimizer(market, p.sizing);
+    vector<opportunity> res;
+    for(auto& r: finder.find()){
+      auto [stake, path] = optimizer.optimize(r, tokens);
+      res.push_back({ stake, move(path) });
+    }
+
+    return res;
+  }
+}
@@ -0,0 +1,344 @@
+#pragma once
+
+#include <eosio/eosio.hpp>
+#include <eosio/asset.hpp>
+
+#include "dex.hpp"
+#include "curve.hpp"
+#include "batch.hpp"
+
+using namespace eosio;
+using namespace std;
+
+namespace market {
+
+  //pair {base}/{quote} tradable on exchange {dex} as resolved from registry.sx
+  struct pair_info {
+    uint8_t         dex;        //index in dex::adapters
+    extended_symbol base;       //base token with its contract
+    extended_symbol quote;      //quote token with its contract
+    uint64_t        pair_id;    //exchange pair id parsed once from registry string
+    uint16_t        index;      //pool index, shared by both listings of the same pool
+
+    //token contract to send {from} tokens with
+    name get_contract(const symbol from) const {
+      return from == base.get_symbol() ? base.get_contract() : quote.get_contract();
+    }
+
+    //memo to trade on this pair towards {to}
+    string get_memo(const symbol to) const {
+      return dex::visit<string>(dex, [&](auto adapter){ return decltype(adapter)::get_memo( pair_id, to ); });
+    }
+  };
+
+  //symbol listed against cache base and exchanges it trades on
+  struct listing {
+    symbol    sym;
+    uint16_t  dexes;    //bit per index in dex::adapters
+
+    uint8_t venues() const {
+      uint8_t res = 0;
+      for(auto m = dexes; m; m &= m - 1) res++;
+      return res;
+    }
+  };
+
+  //registry.sx row of one token on one exchange
+  struct registry_row {
+    extended_symbol                             base;     //token the row is listed under
+    vector<pair<extended_symbol, uint64_t>>     quotes;   //tokens traded against {base} with resolved pair ids
+  };
+
+  //where market data comes from: chain tables in the contract (see chain.hpp), generated or recorded data off-chain
+  //everything is addressed by DEX index in dex::adapters, quoting rules ({curve}, {fee_per_pair}) stay with the adapters
+  class source {
+  public:
+    virtual ~source() = default;
+
+    //registry row of {token} on exchange {dex}
+    //out: false if {token} is not listed there
+    virtual bool get_row(const uint8_t dex, const symbol_code token, registry_row& row) = 0;
+
+    //registry rows of {token} on all exchanges, {rows[dex]} is filled where it is listed
+    //out: bit per index in dex::adapters that has a row
+    virtual uint16_t get_rows(const symbol_code token, array<registry_row, dex::count>& rows){
+      uint16_t res = 0;
+      for(uint8_t dex = 0; dex < dex::count; dex++)
+        if(get_row(dex, token, rows[dex])) res |= 1 << dex;
+      return res;
+    }
+
+    //reserves of pool {pair_id} on exchange {dex} in {base}, {quote} order
+    virtual pair<asset, asset> get_reserves(const uint8_t dex, const uint64_t pair_id, const symbol base, const symbol quote) = 0;
+
+    //trade fee in basis points on exchange {dex}
+    virtual uint8_t get_fee(const uint8_t dex, const symbol base, const symbol quote) = 0;
+
+    //amplifier of curve exchange {dex}
+    virtual int64_t get_amplifier(const uint8_t dex) = 0;
+
+    //return of trading {tokens} to {to} on curve exchange {dex} as calculated by the exchange itself
+    //snapshot quotes curve pools locally, this is the reference to verify it against
+    virtual asset get_amount_out(const uint8_t dex, const uint64_t pair_id, const asset tokens, const symbol to) = 0;
+  };
+
+  //action-scoped cache of pairs tradable against {base} symbol and, on demand, against other tokens
+  //each registry row is read from {source} at most once per action, pair ids are resolved once
+  class pair_cache {
+  public:
+    pair_cache(market::source& source, symbol_code base)
+      : _source(source)
+      , _base(base)
+    {};
+
+    market::source& source() { return _source; }
+
+    symbol_code base() const { return _base; }
+
+    //number of distinct pools loaded so far
+    uint16_t size() const { return _size; }
+
+    //get all pairs of {base} on exchange {dex}, loads registry.sx row on first access
+    const vector<pair_info>& get_pairs(const uint8_t dex){
+      return get_pairs(_base, dex);
+    }
+
+    //get all pairs of {token} on exchange {dex}, loads registry.sx row on first access
+    const vector<pair_info>& get_pairs(const symbol_code token, const uint8_t dex){
+      auto& rows = _rows[token.raw()];
+      if(!rows.loaded[dex]){
+        rows.pairs[dex] = load(token, dex);
+        rows.loaded[dex] = true;
+      }
+      return rows.pairs[dex];
+    }
+
+    //load pairs of all exchanges for {base} with one source call
+    void load_all(){
+      load_all(_base);
+    }
+
+    //load pairs of all exchanges for {token} with one source call
+    void load_all(const symbol_code token){
+      auto& rows = _rows[token.raw()];
+      array<registry_row, dex::count> found;
+      const auto listed = _source.get_rows(token, found);
+      for(uint8_t dex = 0; dex < dex::count; dex++){
+        if(rows.loaded[dex]) continue;
+        if(listed & (1 << dex)) rows.pairs[dex] = make_pairs(token, dex, found[dex]);
+        rows.loaded[dex] = true;
+      }
+    }
+
+    //symbols listed against {base} on at least {min_venues} exchanges
+    vector<listing> get_common(const uint8_t min_venues){
+      return get_common(_base, min_venues);
+    }
+
+    //symbols listed against {token} on at least {min_venues} exchanges
+    //per exchange pairs are kept sorted by quote symbol, so this is one merge pass over all of them
+    //out: listings sorted by symbol
+    vector<listing> get_common(const symbol_code token, const uint8_t min_venues){
+      array<const pair_info*, dex::count> it, end;
+      for(uint8_t dex = 0; dex < dex::count; dex++){
+        const auto& pairs = get_pairs(token, dex);
+        it[dex] = pairs.data();
+        end[dex] = pairs.data() + pairs.size();
+      }
+
+      vector<listing> res;
+      while(true){
+        uint64_t next = UINT64_MAX;
+        for(uint8_t dex = 0; dex < dex::count; dex++)
+          if(it[dex] != end[dex]) next = min(next, it[dex]->quote.get_symbol().raw());
+        if(next == UINT64_MAX) break;
+
+        listing l{ symbol{next}, 0 };
+        for(uint8_t dex = 0; dex < dex::count; dex++){
+          if(it[dex] == end[dex] || it[dex]->quote.get_symbol().raw() != next) continue;
+          l.dexes |= 1 << dex;
+          while(it[dex] != end[dex] && it[dex]->quote.get_symbol().raw() == next) it[dex]++;
+        }
+        if(l.venues() >= min_venues) res.push_back(l);
+      }
+      return res;
+    }
+
+    //find pair to trade {from} to {to} on exchange {dex}
+    //pair can be listed under either token, the one already loaded is searched first
+    //out: pointer to cached pair or nullptr if not traded there
+    const pair_info* find(const uint8_t dex, const symbol from, const symbol to){
+      auto first = from, second = to;
+      if(!is_loaded(from.code(), dex) && is_loaded(to.code(), dex)) swap(first, second);
+
+      for(const auto& p: get_pairs(first.code(), dex))
+        if(p.quote.get_symbol() == second) return &p;
+      for(const auto& p: get_pairs(second.code(), dex))
+        if(p.quote.get_symbol() == first) return &p;
+      return nullptr;
+    }
+
+  private:
+    typedef pair<uint64_t, uint64_t> token_key;                 //{symbol code, contract}
+
+    struct rows {
+      array<vector<pair_info>, dex::count> pairs;
+      array<bool, dex::count> loaded = {};
+    };
+
+    market::source& _source;
+    symbol_code _base;
+    map<uint64_t, rows> _rows;                                  //token symbol code -> its registry rows
+    map<tuple<uint8_t, uint64_t, token_key, token_key>, uint16_t> _pools;  //{dex, pair id, lower token, higher token} -> pool index
+    uint16_t _size = 0;
+
+    bool is_loaded(const symbol_code token, const uint8_t dex) const {
+      const auto it = _rows.find(token.raw());
+      return it != _rows.end() && it->second.loaded[dex];
+    }
+
+    //same pool is listed under both of its tokens, give both entries one index
+    //pools of the same symbols issued by different contracts stay apart
+    uint16_t get_pool_index(const uint8_t dex, const uint64_t pair_id, const extended_symbol& a, const extended_symbol& b){
+      const token_key ka{ a.get_symbol().code().raw(), a.get_contract().value };
+      const token_key kb{ b.get_symbol().code().raw(), b.get_contract().value };
+      const auto key = make_tuple(dex, pair_id, min(ka, kb), max(ka, kb));
+      const auto it = _pools.find(key);
+      if(it != _pools.end()) return it->second;
+      _pools[key] = _size;
+      return _size++;
+    }
+
+    vector<pair_info> load(const symbol_code token, const uint8_t dex){
+      registry_row row;
+      if(!_source.get_row(dex, token, row)) return {};
+      return make_pairs(token, dex, row);
+    }
+
+    vector<pair_info> make_pairs(const symbol_code token, const uint8_t dex, const registry_row& row){
+      vector<pair_info> res;
+      res.reserve(row.quotes.size());
+      for(const auto& [quote, pair_id]: row.quotes)
+        res.push_back({ dex, row.base, quote, pair_id, get_pool_index(dex, pair_id, row.base, quote) });
+
+      //registry.sx rows come sorted, other sources may not
+      const auto by_symbol = [](const pair_info& a, const pair_info& b){ return a.quote.get_symbol().raw() < b.quote.get_symbol().raw(); };
+      if(!is_sorted(res.begin(), res.end(), by_symbol)) sort(res.begin(), res.end(), by_symbol);
+
+      return res;
+    }
+  };
+
+  //constant product pool state seen from the side of the token traded in
+  struct reserves {
+    int64_t   in;         //reserve of token sent to the pool
+    int64_t   out;        //reserve of token received from the pool
+    uint8_t   fee;        //trade fee in basis points
+  };
+
+  //action-scoped snapshot of reserves, fees and amplifiers for pairs in {pairs}
+  //each pair reserve and each DEX setting is read from the exchange at most once, quotes run on memory
+  class snapshot {
+  public:
+    explicit snapshot(pair_cache& pairs)
+      : _pairs(pairs)
+    {
+      _fees.fill(-1);
+      _amplifiers.fill(-1);
+    };
+
+    pair_cache& pairs() { return _pairs; }
+
+    //calculate return of trading {tokens} to {to} on {pair}
+    asset get_amount_out(const pair_info& pair, const asset tokens, const symbol to){
+      if(tokens.amount == 0) return { 0, to };
+
+      return dex::visit<asset>(pair.dex, [&](auto adapter) -> asset {
+        using Dex = decltype(adapter);
+        const auto& pool = get_pool<Dex>(pair);
+        const bool sell = tokens.symbol == pool.reserve0.symbol;
+        const auto& reserve_in = sell ? pool.reserve0 : pool.reserve1;
+        const auto& reserve_out = sell ? pool.reserve1 : pool.reserve0;
+        if(reserve_in.amount == 0 || reserve_out.amount == 0) return { 0, to };
+
+        if constexpr (Dex::curve) return curve::get_amount_out( tokens, reserve_in, reserve_out, pool.amplifier, pool.fee );
+        else return uniswap::get_amount_out( tokens, reserve_in, reserve_out, pool.fee );
+      });
+    }
+
+    //calculate returns of trading {n} amounts {in[i]} of {from} to {to} on {pair} into {out[i]}, stake sweeps
+    //constant product pools run through batch kernel, {in} and {out} may be the same array
+    void get_amounts_out(const pair_info& pair, const symbol from, const symbol to, const int64_t* in, int64_t* out, const size_t n){
+      dex::visit<void>(pair.dex, [&](auto adapter){
+        using Dex = decltype(adapter);
+        const auto& pool = get_pool<Dex>(pair);
+        const bool sell = from == pool.reserve0.symbol;
+        const auto& reserve_in = sell ? pool.reserve0 : pool.reserve1;
+        const auto& reserve_out = sell ? pool.reserve1 : pool.reserve0;
+
+        if constexpr (Dex::curve) {
+          for(size_t i = 0; i < n; i++)
+            out[i] = in[i] > 0 && reserve_in.amount > 0 && reserve_out.amount > 0
+              ? curve::get_amount_out( { in[i], from }, reserve_in, reserve_out, pool.amplifier, pool.fee ).amount : 0;
+        }
+        else batch::get_amounts_out( in, reserve_in.amount, reserve_out.amount, pool.fee, out, n );
+      });
+    }
+
+    //get reserves of {pair} for trading {from} token
+    //out: pool state or nullopt for curve exchanges, their reserves don't price trades directly
+    optional<reserves> get_reserves(const pair_info& pair, const symbol from){
+      return dex::visit<optional<reserves>>(pair.dex, [&](auto adapter) -> optional<reserves> {
+        using Dex = decltype(adapter);
+        if constexpr (Dex::curve) {
+          return nullopt;
+        }
+        else {
+          const auto& pool = get_pool<Dex>(pair);
+          const bool sell = from == pool.reserve0.symbol;
+          return reserves{ sell ? pool.reserve0.amount : pool.reserve1.amount, sell ? pool.reserve1.amount : pool.reserve0.amount, pool.fee };
+        }
+      });
+    }
+
+  private:
+    //reserves are kept in the order of the pair that loaded the pool
+    struct pool {
+      asset     reserve0;
+      asset     reserve1;
+      uint8_t   fee;
+      int64_t   amplifier = 0;    //curve exchanges only
+      bool      loaded = false;
+    };
+
+    pair_cache& _pairs;
+    vector<pool> _pools;
+    array<int16_t, dex::count> _fees;         //-1 until DEX fee is loaded
+    array<int64_t, dex::count> _amplifiers;   //-1 until curve DEX amplifier is loaded
+
+    template <typename Dex>
+    const pool& get_pool(const pair_info& pair){
+      if(pair.index >= _pools.size()) _pools.resize(_pairs.size());
+      auto& pool = _pools[pair.index];
+      if(pool.loaded) return pool;
+
+      const auto base = pair.base.get_symbol(), quote = pair.quote.get_symbol();
+      auto& source = _pairs.source();
+      tie(pool.reserve0, pool.reserve1) = source.get_reserves( pair.dex, pair.pair_id, base, quote );
+      if constexpr (Dex::fee_per_pair) {
+        pool.fee = source.get_fee( pair.dex, base, quote );
+      }
+      else {
+        if(_fees[pair.dex] < 0) _fees[pair.dex] = source.get_fee( pair.dex, base, quote );
+        pool.fee = _fees[pair.dex];
+      }
+      if constexpr (Dex::curve) {
+        if(_amplifiers[pair.dex] < 0) _amplifiers[pair.dex] = source.get_amplifier( pair.dex );
+        pool.amplifier = _amplifiers[pair.dex];
+      }
+      pool.loaded = true;
+
+      return pool;
+    }
+  };
+}
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <eosio/eosio.hpp>
+#include <eosio/asset.hpp>
+#include <eosio/singleton.hpp>
+
+#include "dex.hpp"
+#include "market.hpp"
+#include "chain.hpp"
+
+using namespace eosio;
+using namespace std;
+
+//trader's own index of tradable pairs, mirrored from registry.sx by the refresh action
+namespace pairindex {
+
+  //one registry.sx listing: {quote} traded against {base} on {dex}
+  struct [[eosio::table("pairs")]] pair_row {
+    uint64_t          id;
+    name              dex;          //exchange id, see dex::ids, indexes differ between builds with different exchange sets
+    extended_symbol   base;
+    extended_symbol   quote;
+    uint64_t          pair_id;      //resolved by the DEX adapter, memos are built from it when trading
+
+    uint64_t primary_key() const { return id; }
+    uint128_t by_base() const { return key(base.get_symbol().code(), dex); }
+    uint128_t by_quote() const { return key(quote.get_symbol().code(), dex); }
+
+    //secondary key: all listings of a token sorted by exchange
+    static uint128_t key(const symbol_code token, const name dex){
+      return static_cast<uint128_t>(token.raw()) << 64 | dex.value;
+    }
+  };
+  typedef eosio::multi_index< "pairs"_n, pair_row,
+    indexed_by<"bybase"_n, const_mem_fun<pair_row, uint128_t, &pair_row::by_base>>,
+    indexed_by<"byquote"_n, const_mem_fun<pair_row, uint128_t, &pair_row::by_quote>>
+  > pairs_table;
+
+  //position of the refresh pass over registry.sx tables
+  struct [[eosio::table("pairscursor")]] cursor {
+    uint8_t     dex = 0;            //registry table being mirrored
+    uint64_t    token = 0;          //next registry row to read, symbol_code::raw()
+    uint32_t    passes = 0;         //full passes completed, index is used once it is not 0
+  };
+  typedef eosio::singleton< "pairscursor"_n, cursor > cursor_table;
+
+  //market::source reading pairs from the index and reserves from exchanges
+  //all listings of a token are one range scan on {bybase}
+  class source : public market::chain {
+  public:
+    explicit source(const name self)
+      : _pairs(self, self.value)
+    {};
+
+    bool get_row(const uint8_t dex, const symbol_code token, market::registry_row& row) override {
+      auto idx = _pairs.get_index<"bybase"_n>();
+      bool found = false;
+      const auto key = pair_row::key(token, dex::ids[dex]);
+      for(auto it = idx.lower_bound(key); it != idx.end() && it->by_base() == key; it++){
+        row.base = it->base;
+        row.quotes.push_back({ it->quote, it->pair_id });
+        found = true;
+      }
+      return found;
+    }
+
+    uint16_t get_rows(const symbol_code token, array<market::registry_row, dex::count>& rows) override {
+      auto idx = _pairs.get_index<"bybase"_n>();
+      uint16_t res = 0;
+      for(auto it = idx.lower_bound(pair_row::key(token, name{})); it != idx.end() && it->base.get_symbol().code() == token; it++){
+        const auto dex = dex::index_of(it->dex);
+        if(dex >= dex::count) continue;     //exchange not compiled in
+        auto& row = rows[dex];
+        row.base = it->base;
+        row.quotes.push_back({ it->quote, it->pair_id });
+        res |= 1 << dex;
+      }
+      return res;
+    }
+
+  private:
+    pairs_table _pairs;
+  };
+
+  //is the index complete enough to replace registry.sx lookups
+  inline bool is_ready(const name self){
+    cursor_table cursors(self, self.value);
+    return cursors.get_or_default().passes > 0;
+  }
+
+  //mirror up to {max_rows} registry.sx rows into the index, continuing where the last call stopped
+  //rows of tokens and pairs no longer listed are erased, unchanged rows are not rewritten
+  //out: registry rows processed
+  inline uint32_t refresh(const name self, const uint32_t max_rows){
+    cursor_table cursors(self, self.value);
+    auto cur = cursors.get_or_default();
+    pairs_table pairs(self, self.value);
+    auto idx = pairs.get_index<"bybase"_n>();
+
+    //erase listings on exchange {dex} of tokens in [{from}, {to})
+    const auto prune = [&](const uint8_t dex, const uint64_t from, const uint64_t to){
+      for(auto it = idx.lower_bound(pair_row::key(symbol_code{from}, name{})); it != idx.end() && it->base.get_symbol().code().raw() < to; ){
+        if(it->dex == dex::ids[dex]) it = idx.erase(it);
+        else it++;
+      }
+    };
+
+    //cursor of a build with more exchanges compiled in
+    if(cur.dex >= dex::count) cur.dex = 0, cur.token = 0;
+
+    uint32_t processed = 0;
+    while(processed < max_rows && cur.dex < dex::count){
+      const bool done = dex::visit<bool>(cur.dex, [&](auto adapter){
+        using Dex = decltype(adapter);
+        typename Dex::table table( "registry.sx"_n, "registry.sx"_n.value );
+
+        for(auto rowit = table.lower_bound(cur.token); processed < max_rows; rowit++, processed++){
+          if(rowit == table.end()){
+            prune(cur.dex, cur.token, UINT64_MAX);
+            return true;
+          }
+          const auto token = rowit->base.get_symbol().code();
+          prune(cur.dex, cur.token, token.raw());
+
+          //current listings of {token} on this exchange by quote symbol and contract,
+          //the same symbol can be listed by several token contracts
+          map<pair<uint64_t, uint64_t>, uint64_t> existing;
+          const auto key = pair_row::key(token, dex::ids[cur.dex]);
+          for(auto it = idx.lower_bound(key); it != idx.end() && it->by_base() == key; it++)
+            existing[{ it->quote.get_symbol().raw(), it->quote.get_contract().value }] = it->id;
+
+          for(const auto& [quote, pair_str]: rowit->quotes){
+            const auto pair_id = Dex::get_pair_id(pair_str);
+            const auto update = [&](auto& row){
+              row.dex = dex::ids[cur.dex];
+              row.base = rowit->base;
+              row.quote = quote;
+              row.pair_id = pair_id;
+            };
+
+            const auto ex = existing.find({ quote.get_symbol().raw(), quote.get_contract().value });
+            if(ex == existing.end()){
+              pairs.emplace(self, [&](auto& row){ row.id = pairs.available_primary_key(); update(row); });
+              continue;
+            }
+            const auto& row = pairs.get(ex->second);
+            if(row.quote != quote || row.pair_id != pair_id || row.base != rowit->base) pairs.modify(row, self, update);
+            existing.erase(ex);
+          }
+          for(const auto& [quote, id]: existing) pairs.erase(pairs.get(id));
+
+          cur.token = token.raw() + 1;
+        }
+        return false;
+      });
+
+      if(done){
+        cur.token = 0;
+        if(++cur.dex == dex::count){
+          cur.dex = 0;
+          cur.passes++;
+          break;
+        }
+      }
+    }
+    cursors.set(cur, self);
+
+    return processed;
+  }
+}
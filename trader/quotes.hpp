@@ -0,0 +1,91 @@
+#pragma once
+
+#include <eosio/eosio.hpp>
+#include <eosio/asset.hpp>
+
+#include "market.hpp"
+
+using namespace eosio;
+using namespace std;
+
+namespace quotes {
+
+  //flat quote book: returns of one stake on every pair, stored as parallel arrays
+  //sized once per build and ordered once by {symbol, return}, so picking best venues is a linear pass
+  //i.e. {BOX: 0.1234 BOX@dfs, 0.1345 BOX@defibox}, {BTC: 0.0001 BTC@dfs, ...}
+  class book {
+  public:
+    //quote {tokens} on every pair listed against its symbol in {market}
+    //{common} - when set, only pairs of these symbols are quoted, reserves of other pools are never read
+    void build(market::snapshot& market, const asset tokens, const vector<market::listing>* common = nullptr){
+      size_t total = 0;
+      const auto from = tokens.symbol.code();
+      for(uint8_t dex = 0; dex < dex::count; dex++) total += market.pairs().get_pairs(from, dex).size();
+
+      clear();
+      _syms.reserve(total);
+      _amounts.reserve(total);
+      _dexes.reserve(total);
+      _pairs.reserve(total);
+
+      for(uint8_t dex = 0; dex < dex::count; dex++){
+        auto listed = common ? common->begin() : vector<market::listing>::const_iterator{};
+        for(const auto& pair: market.pairs().get_pairs(from, dex)){
+          const auto to = pair.quote.get_symbol();
+          if(common){
+            //both lists are sorted by symbol, skip to this pair's symbol
+            while(listed != common->end() && listed->sym.raw() < to.raw()) listed++;
+            if(listed == common->end()) break;
+            if(listed->sym != to || !(listed->dexes & (1 << dex))) continue;
+          }
+          const auto out = market.get_amount_out(pair, tokens, to);
+          if(out.amount <= 0) continue;
+          _syms.push_back(to.raw());
+          _amounts.push_back(out.amount);
+          _dexes.push_back(dex);
+          _pairs.push_back(&pair);
+        }
+      }
+
+      _order.resize(_syms.size());
+      for(uint32_t i = 0; i < _order.size(); i++) _order[i] = i;
+      sort(_order.begin(), _order.end(), [&](const uint32_t a, const uint32_t b){
+        return _syms[a] != _syms[b] ? _syms[a] < _syms[b] : _amounts[a] < _amounts[b];
+      });
+    }
+
+    void clear(){
+      _syms.clear();
+      _amounts.clear();
+      _dexes.clear();
+      _pairs.clear();
+      _order.clear();
+    }
+
+    //number of quotes
+    uint32_t size() const { return _order.size(); }
+
+    //quote at position {i} in book order
+    symbol sym(const uint32_t i) const { return symbol{_syms[_order[i]]}; }
+    asset amount(const uint32_t i) const { return { _amounts[_order[i]], sym(i) }; }
+    const market::pair_info& pair(const uint32_t i) const { return *_pairs[_order[i]]; }
+    uint8_t dex(const uint32_t i) const { return _dexes[_order[i]]; }
+
+    //call {f(sym, first, last)} for every symbol in one pass
+    //{first} is the lowest return (best to buy back), {last} the highest (best to sell), both positions in book order
+    template <typename F>
+    void for_each_symbol(F&& f) const {
+      for(uint32_t i = 0, j; i < size(); i = j){
+        for(j = i + 1; j < size() && _syms[_order[j]] == _syms[_order[i]]; j++);
+        f(sym(i), i, j - 1);
+      }
+    }
+
+  private:
+    vector<uint64_t>                    _syms;      //symbol::raw() of tokens bought
+    vector<int64_t>                     _amounts;   //tokens bought
+    vector<uint8_t>                     _dexes;     //index in dex::adapters
+    vector<const market::pair_info*>    _pairs;     //pair quoted
+    vector<uint32_t>                    _order;     //positions sorted by {symbol, amount}
+  };
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+//command line parsing shared by native tools
+namespace args {
+
+  //split "a,b,c" into {"a","b","c"}
+  inline vector<string> split(const string& s, const char sep = ','){
+    vector<string> res;
+    size_t start = 0;
+    for(size_t pos; (pos = s.find(sep, start)) != string::npos; start = pos + 1)
+      res.push_back(s.substr(start, pos - start));
+    res.push_back(s.substr(start));
+    return res;
+  }
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <eosio/eosio.hpp>
+#include <eosio/asset.hpp>
+
+#include <cstring>
+
+using namespace eosio;
+using namespace std;
+
+//binary market snapshots for off-chain replay, written by pack.py
+//the file is read in place: all records are fixed size, little endian and 8 byte aligned,
+//so a mapped file is used as arrays of these structs without parsing or copying
+//
+//layout:
+//  file_header
+//  uint64_t offsets[blocks]     - block start, from the beginning of the file
+//  blocks, each:
+//    block_header
+//    row_record[rows]           - sorted by {dex, token}
+//    quote_record[quotes]       - referenced by rows
+//    pool_record[pools]         - sorted by {dex, pair_id, sym0, sym1}, sym0 < sym1
+namespace replay {
+
+  static constexpr char magic[4] = { 'A', 'R', 'B', 'S' };
+  static constexpr uint16_t version = 2;
+  static constexpr uint8_t max_dexes = 16;
+
+  struct file_header {
+    char      magic[4];
+    uint16_t  version;
+    uint16_t  dexes;                  //entries used in {dex_ids}
+    uint32_t  blocks;
+    uint32_t  reserved;
+    uint64_t  base_sym;               //symbol::raw() of token routes start from
+    uint64_t  base_contract;          //name::value of its contract
+    uint64_t  dex_ids[max_dexes];     //DEX id by file DEX index, name::value of dex::adapters ids
+  };
+
+  struct block_header {
+    uint32_t  block_num;
+    uint32_t  timestamp;              //seconds since epoch
+    uint32_t  rows;
+    uint32_t  quotes;
+    uint32_t  pools;
+    uint32_t  reserved;
+    uint8_t   fees[max_dexes];        //DEX-wide fee in basis points by file DEX index
+    uint32_t  amplifiers[max_dexes];  //curve exchange amplifier by file DEX index, 0 for other exchanges
+  };
+
+  //registry.sx row of {token} on {dex}
+  struct row_record {
+    uint64_t  token;                  //symbol_code::raw()
+    uint64_t  base_sym;               //symbol::raw() of the row base
+    uint64_t  base_contract;
+    uint32_t  first_quote;            //index into block quote records
+    uint32_t  quote_count;
+    uint8_t   dex;                    //file DEX index
+    uint8_t   reserved[7];
+  };
+
+  struct quote_record {
+    uint64_t  sym;                    //symbol::raw()
+    uint64_t  contract;
+    uint64_t  pair_id;                //resolved the way the DEX adapter's get_pair_id does
+  };
+
+  struct pool_record {
+    uint64_t  pair_id;
+    uint64_t  sym0;                   //symbol::raw(), sym0 < sym1
+    int64_t   amount0;
+    uint64_t  sym1;
+    int64_t   amount1;
+    uint8_t   dex;                    //file DEX index
+    uint8_t   fee;                    //pool fee in basis points
+    uint8_t   reserved[6];
+  };
+
+  static_assert(sizeof(file_header) == 160 && sizeof(block_header) == 104, "Snapshot header layout changed");
+  static_assert(sizeof(row_record) == 40 && sizeof(quote_record) == 24 && sizeof(pool_record) == 48, "Snapshot record layout changed");
+
+  //records of one block inside the mapped file
+  struct block {
+    const block_header*   header;
+    const row_record*     rows;
+    const quote_record*   quotes;
+    const pool_record*    pools;
+  };
+
+  //read-only view over a mapped snapshot file
+  class file {
+  public:
+    file(const char* data, const size_t size)
+      : _data(data)
+      , _size(size)
+    {
+      check(size >= sizeof(file_header), "Snapshot file is too short");
+      _header = reinterpret_cast<const file_header*>(data);
+      check(memcmp(_header->magic, magic, sizeof(magic)) == 0, "Not a market snapshot file");
+      check(_header->version == version, "Unsupported snapshot version " + to_string(_header->version));
+      check(_header->dexes <= max_dexes, "Too many exchanges in snapshot");
+      check(size >= sizeof(file_header) + _header->blocks * sizeof(uint64_t), "Snapshot block index is truncated");
+      _offsets = reinterpret_cast<const uint64_t*>(data + sizeof(file_header));
+    };
+
+    const file_header& header() const { return *_header; }
+
+    uint32_t size() const { return _header->blocks; }
+
+    extended_symbol base() const {
+      return { symbol{_header->base_sym}, name{_header->base_contract} };
+    }
+
+    //get records of block number {i} in file order
+    //sizes are compared against bytes left in the file and every row's quotes against the block's quotes,
+    //so a malformed file fails here instead of being read outside the mapping
+    block get(const uint32_t i) const {
+      check(i < size(), "Snapshot block out of range");
+      const uint64_t offset = _offsets[i];
+      check(offset % alignof(uint64_t) == 0, "Snapshot block is misaligned");
+      check(offset <= _size && _size - offset >= sizeof(block_header), "Snapshot block is truncated");
+
+      block res;
+      res.header = reinterpret_cast<const block_header*>(_data + offset);
+      const auto& h = *res.header;
+      const uint64_t records = uint64_t(h.rows) * sizeof(row_record) + uint64_t(h.quotes) * sizeof(quote_record) + uint64_t(h.pools) * sizeof(pool_record);
+      check(records <= _size - offset - sizeof(block_header), "Snapshot block is truncated");
+
+      const char* p = _data + offset + sizeof(block_header);
+      res.rows = reinterpret_cast<const row_record*>(p);
+      p += h.rows * sizeof(row_record);
+      res.quotes = reinterpret_cast<const quote_record*>(p);
+      p += h.quotes * sizeof(quote_record);
+      res.pools = reinterpret_cast<const pool_record*>(p);
+
+      for(uint32_t r = 0; r < h.rows; r++)
+        check(uint64_t(res.rows[r].first_quote) + res.rows[r].quote_count <= h.quotes, "Snapshot row quotes are out of block");
+
+      return res;
+    }
+
+  private:
+    const char* _data;
+    size_t _size;
+    const file_header* _header;
+    const uint64_t* _offsets;
+  };
+}
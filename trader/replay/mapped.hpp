@@ -0,0 +1,45 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <eosio/eosio.hpp>
+
+#include "format.hpp"
+
+using namespace eosio;
+using namespace std;
+
+namespace replay {
+
+  //read-only memory mapping of a snapshot file, unmapped on destruction
+  class mapped {
+  public:
+    explicit mapped(const string& path){
+      const int fd = open(path.c_str(), O_RDONLY);
+      struct stat st;
+      check(fd >= 0 && fstat(fd, &st) == 0, "Can't open " + path);
+      _size = st.st_size;
+      void* data = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+      close(fd);
+      check(data != MAP_FAILED, "Can't map " + path);
+      _data = static_cast<const char*>(data);
+    };
+
+    mapped(const mapped&) = delete;
+    mapped& operator=(const mapped&) = delete;
+
+    ~mapped(){
+      munmap(const_cast<char*>(_data), _size);
+    }
+
+    //snapshots in the mapping
+    file get() const { return { _data, _size }; }
+
+  private:
+    const char* _data;
+    size_t _size;
+  };
+}
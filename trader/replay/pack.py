@@ -0,0 +1,149 @@
+#!/usr/bin/env python3
+# packs JSON market dumps into the binary snapshot format read by replay (see format.hpp)
+#
+# usage: pack.py <out file> <base, i.e. 4,EOS@eosio.token> <dump.json>...
+#
+# every dump file holds one block or a list of blocks:
+# {
+#   "block": 123, "timestamp": 1600000000,
+#   "fees": {"defibox": 30, "dfs": 30, ...},
+#   "amplifiers": {"swap.sx": 20, "stable.sx": 100, ...},
+#   "registry": {"defibox": [<registry.sx row as returned by get_table_rows>, ...], ...},
+#   "pools": [{"dex": "defibox", "pair_id": "12", "reserve0": "1.0000 EOS", "reserve1": "3.1234 USDT", "fee": 30}, ...]
+# }
+
+import json
+import struct
+import sys
+
+VERSION = 2
+MAX_DEXES = 16
+
+# exchanges priced by curve math, blocks listing their pools must record their amplifier
+CURVE_DEXES = ["swap.sx", "stable.sx", "vigor.sx"]
+
+# same order as dex::adapters, replay maps DEXes by id so the order only has to be stable within a file
+DEXES = ["defibox", "dfs", "hamburger", "pizza", "sapex", "swap.sx", "stable.sx", "vigor.sx"]
+
+# registry pair id string -> numeric id, as DEX adapters' get_pair_id do
+PAIR_IDS = {
+    "defibox": lambda s: int(s),
+    "dfs": lambda s: int(s),
+    "hamburger": lambda s: int(s),
+    "pizza": lambda s: name_value(s),
+}
+
+
+def name_value(s):
+    def char_value(c):
+        if c == ".":
+            return 0
+        if "1" <= c <= "5":
+            return ord(c) - ord("1") + 1
+        return ord(c) - ord("a") + 6
+
+    value = 0
+    for i, c in enumerate(s[:13]):
+        if i < 12:
+            value |= (char_value(c) & 0x1F) << (64 - 5 * (i + 1))
+        else:
+            value |= char_value(c) & 0x0F
+    return value
+
+
+def code_value(code):
+    return sum(ord(c) << (8 * i) for i, c in enumerate(code))
+
+
+def symbol_value(s):
+    precision, code = s.split(",")
+    return code_value(code) << 8 | int(precision)
+
+
+def asset_value(s):
+    amount, code = s.split()
+    precision = len(amount.split(".")[1]) if "." in amount else 0
+    return int(amount.replace(".", "")), code_value(code) << 8 | precision
+
+
+def pair_id(dex, s):
+    return PAIR_IDS[dex](str(s)) if dex in PAIR_IDS else 0
+
+
+def pack_block(b):
+    rows, quotes, pools = [], [], []
+
+    for dex, table in b.get("registry", {}).items():
+        d = DEXES.index(dex)
+        for row in table:
+            base = row["base"]
+            first = len(quotes)
+            for q in row["quotes"]:
+                sym = q["key"] if "key" in q else q["first"]
+                pid = q["value"] if "value" in q else q["second"]
+                quotes.append((symbol_value(sym["sym"]), name_value(sym["contract"]), pair_id(dex, pid)))
+            token = symbol_value(base["sym"]) >> 8
+            rows.append((d, token, symbol_value(base["sym"]), name_value(base["contract"]), first, len(quotes) - first))
+
+    for p in b.get("pools", []):
+        d = DEXES.index(p["dex"])
+        a0, s0 = asset_value(p["reserve0"])
+        a1, s1 = asset_value(p["reserve1"])
+        if s1 < s0:
+            (a0, s0), (a1, s1) = (a1, s1), (a0, s0)
+        pools.append((d, pair_id(p["dex"], p.get("pair_id", 0)), s0, s1, a0, a1, p.get("fee", 0)))
+
+    rows.sort(key=lambda r: (r[0], r[1]))
+    pools.sort(key=lambda p: p[:4])
+
+    fees = [0] * MAX_DEXES
+    for dex, fee in b.get("fees", {}).items():
+        fees[DEXES.index(dex)] = fee
+
+    amplifiers = [0] * MAX_DEXES
+    for dex, amplifier in b.get("amplifiers", {}).items():
+        amplifiers[DEXES.index(dex)] = amplifier
+    for dex in set(p["dex"] for p in b.get("pools", [])) & set(CURVE_DEXES):
+        if amplifiers[DEXES.index(dex)] <= 0:
+            sys.exit("block %d: no amplifier for %s pools" % (b["block"], dex))
+
+    out = struct.pack("<IIIIII16B16I", b["block"], b.get("timestamp", 0), len(rows), len(quotes), len(pools), 0, *fees, *amplifiers)
+    for d, token, base_sym, base_contract, first, count in rows:
+        out += struct.pack("<QQQIIB7x", token, base_sym, base_contract, first, count, d)
+    for q in quotes:
+        out += struct.pack("<QQQ", *q)
+    for d, pid, s0, s1, a0, a1, fee in pools:
+        out += struct.pack("<QQqQqBB6x", pid, s0, a0, s1, a1, d, fee)
+    return out
+
+
+def main():
+    if len(sys.argv) < 4:
+        sys.exit("usage: pack.py <out file> <base, i.e. 4,EOS@eosio.token> <dump.json>...")
+
+    sym, contract = sys.argv[2].split("@")
+    blocks = []
+    for path in sys.argv[3:]:
+        with open(path) as f:
+            dump = json.load(f)
+        blocks += dump if isinstance(dump, list) else [dump]
+    blocks.sort(key=lambda b: b["block"])
+
+    ids = [name_value(d) for d in DEXES] + [0] * (MAX_DEXES - len(DEXES))
+    header = struct.pack("<4sHHIIQQ16Q", b"ARBS", VERSION, len(DEXES), len(blocks), 0, symbol_value(sym), name_value(contract), *ids)
+
+    packed = [pack_block(b) for b in blocks]
+    offsets, offset = [], len(header) + 8 * len(blocks)
+    for p in packed:
+        offsets.append(offset)
+        offset += len(p)
+
+    with open(sys.argv[1], "wb") as f:
+        f.write(header)
+        f.write(struct.pack("<%dQ" % len(offsets), *offsets))
+        for p in packed:
+            f.write(p)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,87 @@
+//replays market snapshots through the contract's quote and arbitrage code
+//build and run: scripts/replay.sh <snapshot file> [stake,stake,...] [dex,dex,...]
+//stakes are caps the way mine takes them: the best cycle is sized below the cap, then split across pools
+//out: one line per block and stake - block number, timestamp, split stake, expected profit, route with split legs
+
+#include <eosio/eosio.hpp>
+#include <eosio/asset.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include "../engine.hpp"
+#include "../split.hpp"
+#include "args.hpp"
+#include "format.hpp"
+#include "mapped.hpp"
+#include "source.hpp"
+
+using namespace eosio;
+using namespace std;
+
+int main(int argc, char** argv){
+
+  if(argc < 2){
+    fprintf(stderr, "usage: %s <snapshot file> [stake,stake,...] [dex,dex,...]\n", argv[0]);
+    return 1;
+  }
+
+  const replay::mapped mapping(argv[1]);
+  const auto snapshots = mapping.get();
+  const auto base = snapshots.base();
+  const auto unit = [&]{ int64_t u = 1; for(uint8_t i = 0; i < base.get_symbol().precision(); i++) u *= 10; return u; }();
+
+  //stakes are in whole base tokens, i.e. "10,100,1000"
+  vector<asset> stakes;
+  for(const auto& s: args::split(argc > 2 ? argv[2] : "100"))
+    stakes.push_back({ atoll(s.c_str()) * unit, base.get_symbol() });
+
+  array<bool, dex::count> enabled;
+  enabled.fill(argc <= 3);
+  if(argc > 3){
+    for(const auto& id: args::split(argv[3])){
+      const auto dex = dex::index_of(name{id});
+      check(dex < dex::count, id + " exchange is not supported");
+      enabled[dex] = true;
+    }
+  }
+
+  replay::block_source source(snapshots, enabled);
+  uint64_t evaluations = 0;
+  asset total{ 0, base.get_symbol() };
+  const auto start = chrono::steady_clock::now();
+
+  for(uint32_t i = 0; i < snapshots.size(); i++){
+    source.set(snapshots.get(i));
+
+    for(const auto& stake: stakes){
+      //fresh cache and snapshot per evaluation, same as one mine action
+      market::pair_cache pairs(source, base.get_symbol().code());
+      pairs.load_all();
+      market::snapshot market(pairs);
+
+      const engine::opportunity* best = nullptr;
+      const auto res = engine::get_opportunities(market, stake);
+      for(auto& r: res)
+        if(best == nullptr || r.path.profit > best->path.profit) best = &r;
+      evaluations++;
+
+      if(best == nullptr){
+        printf("%u %u %s - -\n", source.header().block_num, source.header().timestamp, stake.to_string().c_str());
+        continue;
+      }
+      split::optimizer splitter(market);
+      const auto o = splitter.optimize(best->path, best->stake, stake);
+      if(o.profit.amount > 0 && stake == stakes.front()) total += o.profit;
+      printf("%u %u %s %s %s\n", source.header().block_num, source.header().timestamp, o.stake.to_string().c_str(),
+        o.profit.to_string().c_str(), split::to_string(base.get_symbol(), o.legs).c_str());
+    }
+  }
+
+  const auto s = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  fprintf(stderr, "%u blocks, %llu evaluations in %.3f s (%.0f evaluations/s), profit at first stake: %s\n",
+    snapshots.size(), (unsigned long long)evaluations, s, s > 0 ? evaluations / s : 0, total.to_string().c_str());
+
+  return 0;
+}
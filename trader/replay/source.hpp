@@ -0,0 +1,108 @@
+#pragma once
+
+#include <eosio/eosio.hpp>
+#include <eosio/asset.hpp>
+
+#include "../market.hpp"
+#include "format.hpp"
+
+using namespace eosio;
+using namespace std;
+
+namespace replay {
+
+  //market::source over one block of a mapped snapshot file
+  //lookups are binary searches over the mapped records, nothing is copied except rows handed to market::pair_cache
+  //curve exchanges are priced by curve math on recorded reserves, fee and amplifier
+  class block_source : public market::source {
+  public:
+    //{enabled} - DEX indexes in dex::adapters to replay, others are treated as not listing anything
+    block_source(const file& f, const array<bool, dex::count>& enabled)
+    {
+      _map.fill(none);
+      for(uint8_t i = 0; i < f.header().dexes; i++){
+        const auto dex = dex::index_of(name{f.header().dex_ids[i]});
+        if(dex < dex::count && enabled[dex]) _map[dex] = i;
+      }
+    };
+
+    //switch to {b}, pair caches and snapshots built on previous block must not be used anymore
+    void set(const block& b){ _block = b; }
+
+    const block_header& header() const { return *_block.header; }
+
+    bool get_row(const uint8_t dex, const symbol_code token, market::registry_row& row) override {
+      if(_map[dex] == none) return false;
+
+      const auto begin = _block.rows, end = _block.rows + _block.header->rows;
+      const auto key = make_pair(_map[dex], token.raw());
+      const auto it = lower_bound(begin, end, key, [](const row_record& r, const auto& k){
+        return make_pair(r.dex, r.token) < k;
+      });
+      if(it == end || it->dex != key.first || it->token != key.second) return false;
+
+      row.base = { symbol{it->base_sym}, name{it->base_contract} };
+      row.quotes.clear();
+      row.quotes.reserve(it->quote_count);
+      for(auto q = _block.quotes + it->first_quote; q != _block.quotes + it->first_quote + it->quote_count; q++)
+        row.quotes.push_back({ { symbol{q->sym}, name{q->contract} }, q->pair_id });
+      return true;
+    }
+
+    pair<asset, asset> get_reserves(const uint8_t dex, const uint64_t pair_id, const symbol base, const symbol quote) override {
+      const auto pool = find(dex, pair_id, base, quote);
+      if(pool == nullptr) return { {0, base}, {0, quote} };
+
+      const asset a{pool->amount0, symbol{pool->sym0}}, b{pool->amount1, symbol{pool->sym1}};
+      if(a.symbol == base) return { a, b };
+      return { b, a };
+    }
+
+    //exchanges with per pair fee and curve exchanges address pools by symbols only, their pair id is 0
+    //curve fee is recorded on every pool of the exchange
+    uint8_t get_fee(const uint8_t dex, const symbol base, const symbol quote) override {
+      return dex::visit<uint8_t>(dex, [&](auto adapter) -> uint8_t {
+        using Dex = decltype(adapter);
+        if constexpr (Dex::curve || Dex::fee_per_pair) {
+          const auto pool = find(dex, 0, base, quote);
+          return pool ? pool->fee : 0;
+        }
+        else return _map[dex] == none ? 0 : _block.header->fees[_map[dex]];
+      });
+    }
+
+    int64_t get_amplifier(const uint8_t dex) override {
+      return _map[dex] == none ? 0 : _block.header->amplifiers[_map[dex]];
+    }
+
+    asset get_amount_out(const uint8_t dex, const uint64_t pair_id, const asset tokens, const symbol to) override {
+      const auto pool = find(dex, pair_id, tokens.symbol, to);
+      if(pool == nullptr || pool->amount0 == 0 || pool->amount1 == 0) return { 0, to };
+
+      const asset a{pool->amount0, symbol{pool->sym0}}, b{pool->amount1, symbol{pool->sym1}};
+      const bool sell = tokens.symbol == a.symbol;
+      return dex::visit<asset>(dex, [&](auto adapter) -> asset {
+        if constexpr (decltype(adapter)::curve) return curve::get_amount_out( tokens, sell ? a : b, sell ? b : a, get_amplifier(dex), pool->fee );
+        else return uniswap::get_amount_out( tokens, sell ? a : b, sell ? b : a, pool->fee );
+      });
+    }
+
+  private:
+    static constexpr uint8_t none = 0xff;
+
+    array<uint8_t, dex::count> _map;    //DEX index -> file DEX index
+    block _block = {};
+
+    const pool_record* find(const uint8_t dex, const uint64_t pair_id, const symbol a, const symbol b) const {
+      if(_map[dex] == none) return nullptr;
+
+      const auto begin = _block.pools, end = _block.pools + _block.header->pools;
+      const auto key = make_tuple(_map[dex], pair_id, min(a.raw(), b.raw()), max(a.raw(), b.raw()));
+      const auto it = lower_bound(begin, end, key, [](const pool_record& p, const auto& k){
+        return make_tuple(p.dex, p.pair_id, p.sym0, p.sym1) < k;
+      });
+      if(it == end || make_tuple(it->dex, it->pair_id, it->sym0, it->sym1) != key) return nullptr;
+      return it;
+    }
+  };
+}
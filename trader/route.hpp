@@ -0,0 +1,175 @@
+#pragma once
+
+#include <eosio/eosio.hpp>
+#include <eosio/asset.hpp>
+
+#include "market.hpp"
+
+using namespace eosio;
+using namespace std;
+
+//multi-hop arbitrage search: finds cycles base -> token -> ... -> base over all pairs in the market
+namespace route {
+
+  //one trade of a route: trade on {pair} expecting {out}
+  struct leg {
+    const market::pair_info*  pair;
+    asset                     out;
+  };
+
+  //cycle of trades starting and ending with base token
+  struct path {
+    vector<leg>   legs;
+    asset         profit;
+  };
+
+  //"EOS->USDT@dfs->EOS@defibox" for {p} starting with {base}, exchanges named by {names}: dex::ids or dex::accounts
+  inline string to_string(const symbol base, const path& p, const array<name, dex::count>& names = dex::ids){
+    string res = base.code().to_string();
+    for(auto& leg: p.legs)
+      res += "->" + leg.out.symbol.code().to_string() + "@" + names[leg.pair->dex].to_string();
+    return res;
+  }
+
+  //search bounds to fit transaction CPU budget
+  struct params {
+    uint8_t   max_hops = 3;       //longest cycle to look for, 2 is a plain round trip
+    uint8_t   beam = 4;           //tokens expanded to the next hop on each layer
+    uint16_t  max_quotes = 256;   //quotes calculated by the whole search
+    uint8_t   top = 3;            //routes to keep
+  };
+
+  //layered beam search with integer reserve math:
+  //layer N keeps the best amount reached for every token after N trades (larger amount dominates),
+  //every layer is closed back to base, only {beam} tokens closing with the best value are expanded further
+  class finder {
+  public:
+    finder(market::snapshot& market, const asset tokens, const params& p = {})
+      : _market(market)
+      , _tokens(tokens)
+      , _params(p)
+    {
+      _nodes.push_back({ tokens.symbol, tokens, nullptr, -1 });
+    };
+
+    //seed first trade of {tokens} on {pair} returning {out}
+    void add_first(const market::pair_info& pair, const asset out){
+      _layer.push_back(_nodes.size());
+      _nodes.push_back({ out.symbol, out, &pair, 0 });
+    }
+
+    //run the search
+    //out: up to {top} routes ranked by profit, best first
+    vector<path> find(){
+      for(uint8_t hops = 1; hops < _params.max_hops && _layer.size(); hops++){
+
+        //close every token of this layer back to base, score tokens by the best close
+        vector<pair<int64_t, int16_t>> scored;
+        for(auto i: _layer)
+          scored.push_back({ close(i), i });
+
+        if(hops + 1 == _params.max_hops) break;
+
+        sort(scored.begin(), scored.end(), greater<>());
+        if(scored.size() > _params.beam) scored.resize(_params.beam);
+
+        for(auto [score, i]: scored)
+          for(uint8_t dex = 0; dex < dex::count; dex++)
+            extend(i, dex);
+        _layer = take_best();
+      }
+
+      return _routes;
+    }
+
+    //number of quotes the search calculated
+    uint16_t quotes() const { return _quotes; }
+
+  private:
+    struct node {
+      symbol                    sym;
+      asset                     amount;   //best amount of {sym} reached
+      const market::pair_info*  pair;     //pair traded to reach {sym}
+      int16_t                   prev;     //previous node or -1 for base
+    };
+
+    market::snapshot& _market;
+    asset _tokens;
+    params _params;
+    uint16_t _quotes = 0;
+    vector<node> _nodes;
+    vector<int16_t> _layer;
+    map<symbol, int16_t> _next;   //best node per token for the layer being built
+    vector<path> _routes;
+
+    bool spend(){
+      if(_quotes >= _params.max_quotes) return false;
+      _quotes++;
+      return true;
+    }
+
+    bool on_path(int16_t i, const symbol sym) const {
+      for(; i >= 0; i = _nodes[i].prev)
+        if(_nodes[i].sym == sym) return true;
+      return false;
+    }
+
+    //trade node {i} back to base on every exchange and record resulting cycles
+    //out: best amount of base returned or -1 if token can't be traded back
+    int64_t close(const int16_t i){
+      const auto& n = _nodes[i];
+      int64_t best = -1;
+      for(uint8_t dex = 0; dex < dex::count; dex++){
+        const auto pair = _market.pairs().find(dex, n.sym, _tokens.symbol);
+        if(pair == nullptr || pair->index == n.pair->index) continue;
+        if(!spend()) break;
+
+        const auto out = _market.get_amount_out(*pair, n.amount, _tokens.symbol);
+        if(out.amount == 0) continue;
+        best = max(best, out.amount);
+        add_route(i, *pair, out);
+      }
+      return best;
+    }
+
+    //trade node {i} to every token listed against it on exchange {dex}
+    void extend(const int16_t i, const uint8_t dex){
+      const auto from = _nodes[i].sym;
+      const auto amount = _nodes[i].amount;
+      for(const auto& pair: _market.pairs().get_pairs(from.code(), dex)){
+        const auto to = pair.quote.get_symbol();
+        if(to == _tokens.symbol || on_path(i, to)) continue;
+        if(!spend()) return;
+
+        const auto out = _market.get_amount_out(pair, amount, to);
+        if(out.amount == 0) continue;
+
+        auto it = _next.find(to);
+        if(it != _next.end() && _nodes[it->second].amount >= out) continue;
+        _next[to] = _nodes.size();
+        _nodes.push_back({ to, out, &pair, i });
+      }
+    }
+
+    vector<int16_t> take_best(){
+      vector<int16_t> res;
+      for(auto& p: _next) res.push_back(p.second);
+      _next.clear();
+      return res;
+    }
+
+    void add_route(int16_t i, const market::pair_info& pair, const asset out){
+      path route{ {}, out - _tokens };
+      if(_routes.size() >= _params.top && route.profit <= _routes.back().profit) return;
+
+      route.legs.push_back({ &pair, out });
+      for(; i > 0; i = _nodes[i].prev)
+        route.legs.push_back({ _nodes[i].pair, _nodes[i].amount });
+      reverse(route.legs.begin(), route.legs.end());
+
+      auto pos = upper_bound(_routes.begin(), _routes.end(), route, [](const auto& a, const auto& b){ return a.profit > b.profit; });
+      _routes.insert(pos, move(route));
+      if(_routes.size() > _params.top) _routes.pop_back();
+    }
+  };
+}
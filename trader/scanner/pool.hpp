@@ -0,0 +1,77 @@
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+//work-stealing thread pool for off-chain tools
+namespace scanner {
+
+  class pool {
+  public:
+    typedef function<void(size_t worker)> task;
+
+    explicit pool(size_t workers = thread::hardware_concurrency())
+      : _queues(workers ? workers : 1)
+    {};
+
+    size_t size() const { return _queues.size(); }
+
+    //queue {t}, tasks are spread round robin over workers
+    void add(task t){
+      auto& q = _queues[_next++ % _queues.size()];
+      lock_guard<mutex> lock(q.lock);
+      q.tasks.push_back(move(t));
+    }
+
+    //run all queued tasks and wait for them
+    //each worker takes its own tasks newest first and steals the oldest ones from others when it runs out
+    void run(){
+      vector<thread> threads;
+      for(size_t i = 1; i < _queues.size(); i++)
+        threads.emplace_back([this, i]{ work(i); });
+      work(0);
+      for(auto& t: threads) t.join();
+    }
+
+  private:
+    struct queue {
+      mutex         lock;
+      deque<task>   tasks;
+    };
+
+    vector<queue> _queues;
+    size_t _next = 0;
+
+    bool pop(const size_t i, task& t){
+      auto& q = _queues[i];
+      lock_guard<mutex> lock(q.lock);
+      if(q.tasks.empty()) return false;
+      t = move(q.tasks.back());
+      q.tasks.pop_back();
+      return true;
+    }
+
+    bool steal(const size_t i, task& t){
+      for(size_t k = 1; k < _queues.size(); k++){
+        auto& q = _queues[(i + k) % _queues.size()];
+        lock_guard<mutex> lock(q.lock);
+        if(q.tasks.empty()) continue;
+        t = move(q.tasks.front());
+        q.tasks.pop_front();
+        return true;
+      }
+      return false;
+    }
+
+    //no tasks are added while running, so a worker that finds every queue empty is done
+    void work(const size_t i){
+      task t;
+      while(pop(i, t) || steal(i, t)) t(i);
+    }
+  };
+}
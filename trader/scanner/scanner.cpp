@@ -0,0 +1,172 @@
+//multi-threaded off-chain arbitrage scanner on the contract's pricing code
+//build and run: scripts/scan.sh <snapshot file> <executor> <min profit bp> <stake,stake,...> [base;base;...] [threads]
+//  base - i.e. 4,EOS@eosio.token, defaults to the snapshot base
+//  stake - caps the way mine takes them, every candidate is sized below its cap and split across pools like mine executes it
+//out: one line per candidate clearing {min profit bp} of its split stake, best first:
+//  mine action payload with the cap, split stake, expected profit, route with split legs
+
+#include <eosio/eosio.hpp>
+#include <eosio/asset.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+
+#include "../engine.hpp"
+#include "../split.hpp"
+#include "../replay/args.hpp"
+#include "../replay/mapped.hpp"
+#include "../replay/source.hpp"
+#include "pool.hpp"
+
+using namespace eosio;
+using namespace std;
+
+namespace scanner {
+
+  //pluggable pool state: hands every worker its own market::source over the same market state
+  class state {
+  public:
+    virtual ~state() = default;
+    virtual unique_ptr<market::source> make_source() = 0;
+  };
+
+  //stand-in for a live node: one block of a snapshot file (see replay/format.hpp)
+  class file_state : public state {
+  public:
+    file_state(const string& path, const optional<uint32_t> block = nullopt)
+      : _mapping(path)
+      , _file(_mapping.get())
+    {
+      check(_file.size() > 0, "Snapshot file has no blocks");
+      _block = _file.get(block ? *block : _file.size() - 1);
+    };
+
+    const replay::file& file() const { return _file; }
+
+    unique_ptr<market::source> make_source() override {
+      array<bool, dex::count> enabled;
+      enabled.fill(true);
+      auto res = make_unique<replay::block_source>(_file, enabled);
+      res->set(_block);
+      return res;
+    }
+
+  private:
+    replay::mapped _mapping;
+    replay::file _file;
+    replay::block _block;
+  };
+
+  //one unit of work: cycles of {stake} base tokens whose first trade buys {first}
+  struct candidate {
+    extended_asset            stake;      //cap sent to mine
+    symbol                    first;
+    asset                     split_stake;
+    asset                     profit;
+    string                    route;
+    bool                      found = false;
+  };
+}
+
+//"4,EOS@eosio.token" -> {4,EOS, eosio.token}
+static extended_symbol parse_base(const string& s){
+  const auto at = s.find('@');
+  const auto comma = s.find(',');
+  check(at != string::npos && comma != string::npos && comma < at, "Base should look like 4,EOS@eosio.token: " + s);
+  return { symbol{ symbol_code{s.substr(comma + 1, at - comma - 1)}, uint8_t(atoi(s.substr(0, comma).c_str())) }, name{s.substr(at + 1)} };
+}
+
+int main(int argc, char** argv){
+
+  if(argc < 5){
+    fprintf(stderr, "usage: %s <snapshot file> <executor> <min profit bp> <stake,stake,...> [base;base;...] [threads]\n", argv[0]);
+    return 1;
+  }
+
+  scanner::file_state state(argv[1]);
+  const name executor{string(argv[2])};
+  const int64_t min_profit_bp = atoll(argv[3]);
+
+  vector<extended_symbol> bases;
+  if(argc > 5) for(const auto& b: args::split(argv[5], ';')) bases.push_back(parse_base(b));
+  else bases.push_back(state.file().base());
+
+  scanner::pool pool(argc > 6 ? atoi(argv[6]) : thread::hardware_concurrency());
+  vector<unique_ptr<market::source>> sources;
+  for(size_t i = 0; i < pool.size(); i++) sources.push_back(state.make_source());
+
+  const auto start = chrono::steady_clock::now();
+
+  //plan: tokens kept by the spot price screen for every base, then one candidate per {base, stake, first token}
+  vector<scanner::candidate> candidates;
+  for(const auto& base: bases){
+    int64_t unit = 1;
+    for(uint8_t i = 0; i < base.get_symbol().precision(); i++) unit *= 10;
+
+    vector<asset> stakes;
+    for(const auto& s: args::split(argv[4]))
+      stakes.push_back({ atoll(s.c_str()) * unit, base.get_symbol() });
+
+    market::pair_cache pairs(*sources[0], base.get_symbol().code());
+    pairs.load_all();
+    market::snapshot market(pairs);
+    const engine::params p;
+    for(const auto& l: engine::screen(market, stakes.front(), p.min_venues, p.prune))
+      for(const auto& stake: stakes)
+        candidates.push_back({ { stake, base.get_contract() }, l.sym });
+  }
+
+  //scan: every task builds its own cache and snapshot on its worker's source
+  for(auto& c: candidates){
+    pool.add([&c, &sources](size_t worker){
+      const auto tokens = c.stake.quantity;
+      market::pair_cache pairs(*sources[worker], tokens.symbol.code());
+      pairs.load_all();
+      market::snapshot market(pairs);
+
+      //best cycle, then split, as mine does; legs point into this task's cache so only amounts and the route are kept
+      const engine::opportunity* top = nullptr;
+      const auto res = engine::get_opportunities(market, tokens, {}, c.first);
+      for(auto& r: res)
+        if(top == nullptr || r.path.profit > top->path.profit) top = &r;
+      if(top == nullptr) return;
+
+      split::optimizer splitter(market);
+      const auto o = splitter.optimize(top->path, top->stake, tokens);
+      c.split_stake = o.stake;
+      c.profit = o.profit;
+      c.route = split::to_string(tokens.symbol, o.legs);
+      c.found = true;
+    });
+  }
+  pool.run();
+
+  //emit: candidates clearing the threshold, one payload per base and stake, best first
+  map<tuple<uint64_t, uint64_t, int64_t>, const scanner::candidate*> best;
+  for(const auto& c: candidates){
+    if(!c.found || c.profit.amount <= 0) continue;
+    if(c.profit.amount * 10000 < c.split_stake.amount * min_profit_bp) continue;
+    auto& b = best[{ c.stake.quantity.symbol.raw(), c.stake.contract.value, c.stake.quantity.amount }];
+    if(b == nullptr || c.profit > b->profit) b = &c;
+  }
+  vector<const scanner::candidate*> hits;
+  for(auto& p: best) hits.push_back(p.second);
+  sort(hits.begin(), hits.end(), [](auto a, auto b){
+    const auto& pa = a->profit, pb = b->profit;
+    return pa.symbol == pb.symbol ? pa > pb : pa.symbol < pb.symbol;
+  });
+
+  const auto s = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  fprintf(stderr, "%zu candidates on %zu threads in %.3f ms, %zu above %lld bp\n",
+    candidates.size(), pool.size(), s * 1000, hits.size(), (long long)min_profit_bp);
+
+  for(auto c: hits){
+    printf("[\"%s\",{\"quantity\":\"%s\",\"contract\":\"%s\"}]\t%s\t%s\t%s\n",
+      executor.to_string().c_str(), c->stake.quantity.to_string().c_str(), c->stake.contract.to_string().c_str(),
+      c->split_stake.to_string().c_str(), c->profit.to_string().c_str(), c->route.c_str());
+  }
+
+  return 0;
+}
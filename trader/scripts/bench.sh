@@ -0,0 +1,5 @@
+#!/bin/bash
+# native build of the quote engine with synthetic markets, no chain needed
+# usage: scripts/bench.sh [dexes] [pairs] [iterations] [stake] [tokens]
+
+eosio-cpp -fnative -O3 bench/bench.cpp -I ../include -o bench.out && ./bench.out "$@"
@@ -1,5 +1,10 @@
 #!/bin/bash
 cleos wallet unlock --password $(cat ~/eosio-wallet/.pass)
 
-eosio-cpp trader.cpp -I ../include
-cleos -u https://eos.eosn.io set contract basic.sx . basic.wasm basic.abi -p basic.sx@active
\ No newline at end of file
+#pass "debug" to print evaluated routes and trades, other arguments go to eosio-cpp
+#i.e. scripts/build.sh -DTRADER_DEX_SAPEX=0 to deploy without sapex
+FLAGS=""
+[ "$1" == "debug" ] && FLAGS="-DTRADER_DEBUG" && shift
+
+eosio-cpp basic.cpp -o basic.wasm -I ../include $FLAGS "$@"
+cleos -u https://eos.eosn.io set contract basic.sx . basic.wasm basic.abi -p basic.sx@active
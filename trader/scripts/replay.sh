@@ -0,0 +1,6 @@
+#!/bin/bash
+# native replay of market snapshots through the quote engine
+# usage: scripts/replay.sh <snapshot file> [stake,stake,...] [dex,dex,...]
+# snapshots are packed from JSON dumps: replay/pack.py <out file> 4,EOS@eosio.token <dump.json>...
+
+eosio-cpp -fnative -O3 replay/replay.cpp -I ../include -o replay.out && ./replay.out "$@"
@@ -0,0 +1,7 @@
+#!/bin/bash
+# native multi-threaded opportunity scanner, emits mine payloads for profitable candidates
+# usage: scripts/scan.sh <snapshot file> <executor> <min profit bp> <stake,stake,...> [base;base;...] [threads]
+# every line: mine payload with the stake cap, split stake, expected profit, route
+# i.e. scripts/scan.sh market.arbs miner.sx 5 10,100,1000 "4,EOS@eosio.token" | cut -f1 | xargs -I{} cleos push action basic.sx mine '{}' -p basic.sx
+
+eosio-cpp -fnative -O3 -pthread scanner/scanner.cpp -I ../include -o scan.out && ./scan.out "$@"
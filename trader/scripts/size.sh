@@ -0,0 +1,20 @@
+#!/bin/bash
+# WASM size of the contract and what every exchange adds to it
+# usage: scripts/size.sh [extra eosio-cpp flags]
+# out: size with all exchanges, then bytes saved by building without each of them
+
+OUT=$(mktemp -d)
+trap 'rm -rf $OUT' EXIT
+
+# runs in a $(...) subshell, callers check its status
+build(){
+  eosio-cpp basic.cpp -o $OUT/basic.wasm -I ../include "$@" > /dev/null && wc -c < $OUT/basic.wasm
+}
+
+full=$(build "$@") || { echo "build with all exchanges failed" >&2; exit 1; }
+echo "all exchanges: $full bytes"
+for dex in DEFIBOX DFS HAMBURGER PIZZA SAPEX SWAPSX STABLESX VIGORSX; do
+  size=$(build "$@" -DTRADER_DEX_$dex=0) || { echo "build without $dex failed" >&2; exit 1; }
+  printf "  %-10s %8d bytes\n" $(echo $dex | tr A-Z a-z) $((full - size))
+done
+
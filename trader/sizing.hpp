@@ -0,0 +1,118 @@
+#pragma once
+
+#include <eosio/eosio.hpp>
+#include <eosio/asset.hpp>
+
+#include <cmath>
+
+#include "market.hpp"
+#include "route.hpp"
+
+using namespace eosio;
+using namespace std;
+
+//stake sizing: find the input that maximizes profit of a route, up to a cap
+namespace sizing {
+
+  //search bounds for routes that go through curve exchanges
+  struct params {
+    uint8_t   max_evals = 24;     //route evaluations of the integer search per route
+    int64_t   min_step = 1;       //stop the search when the interval is this narrow
+  };
+
+  //stake and the route it was sized for
+  struct result {
+    asset         stake;          //amount to borrow
+    route::path   path;           //route with outputs recalculated for {stake}
+  };
+
+  class optimizer {
+  public:
+    optimizer(market::snapshot& market, const params& p = {})
+      : _market(market)
+      , _params(p)
+    {};
+
+    //size {path} found for {cap} tokens
+    //constant product routes collapse into one virtual pool with a closed form optimum,
+    //routes with curve legs use a bounded ternary search as profit is concave in stake
+    //out: best stake in [1, {cap}] and the route evaluated at it
+    result optimize(const route::path& path, const asset cap){
+      int64_t best = cap.amount;
+      if(const auto x = get_closed_form(path, cap.symbol)){
+        best = clamp<int64_t>(*x, 1, cap.amount);
+      }
+      else {
+        best = search(path, cap);
+      }
+
+      auto res = evaluate(path, { best, cap.symbol });
+      if(best != cap.amount){
+        auto at_cap = evaluate(path, cap);
+        if(at_cap.path.profit > res.path.profit) res = move(at_cap);
+      }
+      return res;
+    }
+
+    //recalculate every leg of {path} for {stake}
+    result evaluate(const route::path& path, const asset stake){
+      result res{ stake, path };
+      auto amount = stake;
+      for(auto& leg: res.path.legs){
+        amount = _market.get_amount_out(*leg.pair, amount, leg.out.symbol);
+        leg.out = amount;
+      }
+      res.path.profit = amount - stake;
+      return res;
+    }
+
+  private:
+    market::snapshot& _market;
+    params _params;
+
+    //chain of constant product pools a->b->...->a acts as one pool {ea, eb} with fee of the first leg:
+    //out = r*x*eb / (ea + r*x), profit is maximal where its derivative is 1: x = (sqrt(r*ea*eb) - ea) / r
+    //out: optimal stake or nullopt if any leg is a curve exchange
+    optional<int64_t> get_closed_form(const route::path& path, symbol from){
+      double ea = 0, eb = 0, r = 0;
+      for(auto& leg: path.legs){
+        const auto res = _market.get_reserves(*leg.pair, from);
+        if(!res) return nullopt;
+        if(res->in == 0 || res->out == 0) return 0;
+
+        const double fee = (10000 - res->fee) / 10000.0;
+        if(r == 0){
+          ea = res->in, eb = res->out, r = fee;
+        }
+        else {
+          const double d = res->in + fee * eb;
+          ea = ea * res->in / d;
+          eb = fee * eb * res->out / d;
+        }
+        from = leg.out.symbol;
+      }
+      if(r * eb <= ea) return 0;    //not profitable at any stake
+
+      return static_cast<int64_t>((sqrt(r * ea * eb) - ea) / r);
+    }
+
+    //integer ternary search over (0, cap], both probes of a step run through every leg as one batch
+    int64_t search(const route::path& path, const asset cap){
+      int64_t lo = 1, hi = cap.amount;
+      for(uint8_t evals = 0; evals + 2 <= _params.max_evals && hi - lo > max<int64_t>(_params.min_step, 2); evals += 2){
+        const int64_t m1 = lo + (hi - lo) / 3;
+        const int64_t m2 = hi - (hi - lo) / 3;
+
+        int64_t amounts[2] = { m1, m2 };
+        auto from = cap.symbol;
+        for(auto& leg: path.legs){
+          _market.get_amounts_out(*leg.pair, from, leg.out.symbol, amounts, amounts, 2);
+          from = leg.out.symbol;
+        }
+        if(amounts[0] - m1 < amounts[1] - m2) lo = m1;
+        else hi = m2;
+      }
+      return lo + (hi - lo) / 2;
+    }
+  };
+}
@@ -0,0 +1,200 @@
+#pragma once
+
+#include <eosio/eosio.hpp>
+#include <eosio/asset.hpp>
+
+#include "market.hpp"
+#include "route.hpp"
+
+using namespace eosio;
+using namespace std;
+
+//order splitting: trade every leg of a route on several pools of the same pair at once to cut price impact
+namespace split {
+
+  //search bounds to fit transaction CPU budget
+  struct params {
+    uint8_t   chunks = 8;         //first allocation unit is 1/{chunks} of the leg input
+    uint8_t   refine = 6;         //halvings of the allocation unit while rebalancing
+    uint8_t   max_moves = 8;      //rebalancing moves per allocation unit
+    uint8_t   max_evals = 12;     //route evaluations of the stake search above the single pool optimum
+  };
+
+  //part of a leg traded on one pool
+  struct part {
+    const market::pair_info*  pair;
+    asset                     in;
+    asset                     out;
+  };
+
+  //leg of a route split across pools, parts with the largest input first
+  struct leg {
+    vector<part>  parts;
+    asset         out;            //sum of {parts} returns
+  };
+
+  //split route evaluated for {stake}
+  struct result {
+    asset         stake;
+    vector<leg>   legs;
+    asset         profit;
+  };
+
+  //"EOS->USDT@dfs+defibox->EOS@defibox" for {legs} starting with {base}, exchanges of every leg's parts joined by '+'
+  inline string to_string(const symbol base, const vector<leg>& legs, const array<name, dex::count>& names = dex::ids){
+    string res = base.code().to_string();
+    for(auto& l: legs){
+      res += "->" + l.out.symbol.code().to_string() + "@";
+      for(size_t i = 0; i < l.parts.size(); i++)
+        res += (i ? "+" : "") + names[l.parts[i].pair->dex].to_string();
+    }
+    return res;
+  }
+
+  class optimizer {
+  public:
+    optimizer(market::snapshot& market, const params& p = {})
+      : _market(market)
+      , _params(p)
+    {};
+
+    //split {path} sized for {stake} by sizing::optimizer, then search larger stakes up to {cap}
+    //as splitting lowers price impact, profit of a split route peaks at a larger stake
+    //out: best split route found, never worse than {path} at {stake}
+    result optimize(const route::path& path, const asset stake, const asset cap){
+      const auto pools = get_pools(path);
+      auto best = evaluate(path, pools, stake);
+      if(cap.amount <= stake.amount) return best;
+
+      //integer ternary search over [stake, cap], profit is concave in stake
+      //a leg split over n pools is at most n times deeper, so its optimum is below n times {stake}
+      size_t widest = 1;
+      for(auto& p: pools) widest = max(widest, p.size());
+      int64_t lo = stake.amount, hi = min<int64_t>(cap.amount, stake.amount * widest);
+      for(uint8_t evals = 0; evals + 2 <= _params.max_evals && hi - lo > 2; evals += 2){
+        const int64_t m1 = lo + (hi - lo) / 3;
+        const int64_t m2 = hi - (hi - lo) / 3;
+        auto r1 = evaluate(path, pools, { m1, cap.symbol });
+        auto r2 = evaluate(path, pools, { m2, cap.symbol });
+        if(r1.profit < r2.profit) lo = m1;
+        else hi = m2;
+
+        auto& r = r1.profit < r2.profit ? r2 : r1;
+        if(r.profit > best.profit) best = move(r);
+      }
+      return best;
+    }
+
+    //split every leg of {path} for {stake}
+    result evaluate(const route::path& path, const asset stake){
+      return evaluate(path, get_pools(path), stake);
+    }
+
+    //divide {tokens} between {pools} trading to {to} by integer marginal returns:
+    //every unit goes to the pool returning most for it, then units are moved between pools while the total grows,
+    //halving the unit on each round until returns are equalized
+    //out: parts with non-zero input, at least as good as trading everything on the first pool
+    leg divide(const vector<const market::pair_info*>& pools, const asset tokens, const symbol to){
+      const auto n = pools.size();
+      const auto quote = [&](const size_t i, const int64_t amount) -> int64_t {
+        return amount > 0 ? _market.get_amount_out(*pools[i], { amount, tokens.symbol }, to).amount : 0;
+      };
+
+      vector<int64_t> in(n, 0), out(n, 0);
+      int64_t unit = max<int64_t>(tokens.amount / _params.chunks, 1);
+      for(int64_t left = tokens.amount; left > 0 && n > 1; ){
+        const auto step = min(unit, left);
+        size_t best = 0;
+        int64_t best_out = -1;
+        for(size_t i = 0; i < n; i++){
+          const auto o = quote(i, in[i] + step);
+          if(best_out < 0 || o - out[i] > best_out - out[best]) best = i, best_out = o;
+        }
+        in[best] += step;
+        out[best] = best_out;
+        left -= step;
+      }
+
+      for(uint8_t round = 0; round < _params.refine && unit > 1 && n > 1; round++){
+        unit /= 2;
+        for(uint8_t moves = 0; moves < _params.max_moves; moves++){
+          //gain of adding {unit} to each pool and loss of taking it from each pool
+          vector<int64_t> gain(n), loss(n);
+          for(size_t i = 0; i < n; i++){
+            gain[i] = quote(i, in[i] + unit) - out[i];
+            loss[i] = in[i] >= unit ? out[i] - quote(i, in[i] - unit) : INT64_MAX;
+          }
+          size_t add = 0, take = 0;
+          int64_t best = 0;
+          for(size_t i = 0; i < n; i++)
+            for(size_t j = 0; j < n; j++)
+              if(i != j && loss[j] != INT64_MAX && gain[i] - loss[j] > best) best = gain[i] - loss[j], add = i, take = j;
+          if(best <= 0) break;
+
+          in[add] += unit, out[add] += gain[add];
+          in[take] -= unit, out[take] -= loss[take];
+        }
+      }
+
+      leg res{ {}, { 0, to } };
+      for(size_t i = 0; i < n; i++){
+        if(in[i] == 0) continue;
+        res.parts.push_back({ pools[i], { in[i], tokens.symbol }, { out[i], to } });
+        res.out.amount += out[i];
+      }
+
+      //integer rounding can make a split lose to the single pool it started from
+      const auto single = quote(0, tokens.amount);
+      if(res.parts.empty() || single >= res.out.amount)
+        res = { { { pools[0], tokens, { single, to } } }, { single, to } };
+
+      sort(res.parts.begin(), res.parts.end(), [](const part& a, const part& b){ return a.in > b.in; });
+      return res;
+    }
+
+  private:
+    market::snapshot& _market;
+    params _params;
+
+    //pools every leg may trade on: its own pool first, then pools of the same pair on other exchanges
+    //a pool is used by one leg only, as the snapshot doesn't see reserves changed by earlier legs
+    vector<vector<const market::pair_info*>> get_pools(const route::path& path){
+      vector<uint16_t> used;
+      for(auto& l: path.legs) used.push_back(l.pair->index);
+
+      vector<vector<const market::pair_info*>> res(path.legs.size());
+      auto from = path.profit.symbol;
+      for(size_t i = 0; i < path.legs.size(); i++){
+        const auto& own = *path.legs[i].pair;
+        const auto to = path.legs[i].out.symbol;
+        res[i].push_back(&own);
+        for(uint8_t dex = 0; dex < dex::count; dex++){
+          if(dex == own.dex) continue;
+          const auto pair = _market.pairs().find(dex, from, to);
+          if(pair == nullptr || find(used.begin(), used.end(), pair->index) != used.end()) continue;
+
+          //same symbol can be issued by different contracts on different exchanges
+          if(pair->get_contract(from) != own.get_contract(from) || pair->get_contract(to) != own.get_contract(to)) continue;
+
+          used.push_back(pair->index);
+          res[i].push_back(pair);
+        }
+        from = to;
+      }
+      return res;
+    }
+
+    result evaluate(const route::path& path, const vector<vector<const market::pair_info*>>& pools, const asset stake){
+      result res{ stake, {}, {} };
+      res.legs.reserve(path.legs.size());
+      auto amount = stake;
+      for(size_t i = 0; i < path.legs.size(); i++){
+        res.legs.push_back(divide(pools[i], amount, path.legs[i].out.symbol));
+        amount = res.legs.back().out;
+        if(amount.amount == 0) break;
+      }
+      res.profit = { amount.amount - stake.amount, stake.symbol };
+      return res;
+    }
+  };
+}